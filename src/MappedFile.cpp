@@ -0,0 +1,120 @@
+#include "MappedFile.h"
+#include <kodi/AddonBase.h>
+#include <kodi/Filesystem.h>
+#include "Utils.h"
+
+#ifdef TARGET_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+  Close();
+  if (Map(kodi::vfs::TranslateSpecialProtocol(path)))
+  {
+    return true;
+  }
+  m_buffer = Utils::ReadFile(path);
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+  return !m_buffer.empty();
+}
+
+#ifdef TARGET_WINDOWS
+bool MappedFile::Map(const std::string& localPath)
+{
+  HANDLE file = CreateFileA(localPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  m_fileHandle = file;
+  m_mappingHandle = mapping;
+  m_data = static_cast<const char*>(data);
+  m_size = static_cast<size_t>(size.QuadPart);
+  m_mapped = true;
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if (m_mapped)
+  {
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mappingHandle);
+    CloseHandle(m_fileHandle);
+    m_mapped = false;
+  }
+  m_buffer.clear();
+  m_data = nullptr;
+  m_size = 0;
+}
+#else
+bool MappedFile::Map(const std::string& localPath)
+{
+  int fd = open(localPath.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    close(fd);
+    return false;
+  }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after closing the descriptor
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    return false;
+  }
+  m_data = static_cast<const char*>(data);
+  m_size = static_cast<size_t>(st.st_size);
+  m_mapped = true;
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if (m_mapped)
+  {
+    munmap(const_cast<char*>(m_data), m_size);
+    m_mapped = false;
+  }
+  m_buffer.clear();
+  m_data = nullptr;
+  m_size = 0;
+}
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a local file. Paths are resolved through the
+// kodi special protocol. If the file cannot be mapped, e.g. because it is not
+// on a local file system, its content is read into memory instead.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  bool Open(const std::string& path);
+  void Close();
+  std::string_view View() const { return std::string_view(m_data, m_size); }
+private:
+  bool Map(const std::string& localPath);
+  const char* m_data = nullptr;
+  size_t m_size = 0;
+  bool m_mapped = false;
+  std::string m_buffer;
+#ifdef TARGET_WINDOWS
+  void* m_fileHandle = nullptr;
+  void* m_mappingHandle = nullptr;
+#endif
+};
@@ -3,6 +3,26 @@
 #include <kodi/General.h>
 #include "TeleBoy.h"
 
+// refresh the session in the background before Teleboy expires it
+static const time_t SESSION_REFRESH_INTERVAL = 60 * 60 * 4;
+// delay until a failed refresh is tried again
+static const time_t SESSION_REFRESH_RETRY = 60 * 15;
+// maximum time api calls wait for a running login
+static const int LOGIN_WAIT_SECONDS = 15;
+
+// Teleboy may send the login to t.teleboy.ch instead of www.teleboy.ch, the
+// same host prefix is swapped on the configured website
+static std::string GetAlternativeWebUrl()
+{
+  std::string url = TELEBOY_WEB_URL;
+  size_t pos = url.find("://www.");
+  if (pos != std::string::npos)
+  {
+    url.replace(pos + 3, 3, "t");
+  }
+  return url;
+}
+
 Session::Session(HttpClient* httpClient, TeleBoy* teleBoy):
   m_httpClient(httpClient),
   m_teleBoy(teleBoy)
@@ -12,6 +32,7 @@ Session::Session(HttpClient* httpClient, TeleBoy* teleBoy):
 Session::~Session()
 {
   m_running = false;
+  m_condition.notify_all();
   if (m_thread.joinable())
     m_thread.join();  
 }
@@ -30,13 +51,24 @@ ADDON_STATUS Session::Start()
 void Session::LoginThread() {
   while (m_running) {
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait_for(lock, std::chrono::milliseconds(500),
+          [this] { return !m_running || !m_isConnected; });
+    }
+    if (!m_running) {
+      break;
+    }
     
     if (m_isConnected) {
+      if (m_sessionStart + SESSION_REFRESH_INTERVAL <= std::time(0)) {
+        RefreshSession();
+      }
       continue;
     }
     
     if (m_nextLoginAttempt > std::time(0)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
       continue;
     }
     
@@ -48,13 +80,20 @@ void Session::LoginThread() {
     m_enableDolby = kodi::addon::GetSettingBoolean("enableDolby");
     
     kodi::Log(ADDON_LOG_DEBUG, "Login Teleboy");
-    if (Login(teleboyUsername, teleboyPassword))
+    SetLoginInProgress(true);
+    if (Login(*m_httpClient, teleboyUsername, teleboyPassword, false))
     {
       if (!m_teleBoy->SessionInitialized()) {
         m_nextLoginAttempt = std::time(0) + 60;
+        SetLoginInProgress(false);
         continue;
       }
-      m_isConnected = true;
+      m_sessionStart = std::time(0);
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isConnected = true;
+      }
+      SetLoginInProgress(false);
       kodi::Log(ADDON_LOG_DEBUG, "Login done");
       m_teleBoy->UpdateConnectionState("Teleboy connection established", PVR_CONNECTION_STATE_CONNECTED, "");
       kodi::QueueNotification(QUEUE_INFO, "", kodi::addon::GetLocalizedString(30105));
@@ -63,73 +102,115 @@ void Session::LoginThread() {
     {
       kodi::Log(ADDON_LOG_ERROR, "Login failed");
       m_nextLoginAttempt = std::time(0) + 3600;
+      SetLoginInProgress(false);
       kodi::QueueNotification(QUEUE_ERROR, "", kodi::addon::GetLocalizedString(30101));
     }
   }
 }
 
-bool Session::Login(string u, string p)
+// Logs in again with a separate client, which shares rate limits and
+// circuits with the main one, while the current session keeps serving
+// requests. The new session replaces it only if the login succeeds,
+// an expired session is still handled by the reset on error 10403.
+void Session::RefreshSession() {
+  kodi::Log(ADDON_LOG_DEBUG, "Refresh Teleboy session");
+  std::string teleboyUsername = kodi::addon::GetSettingString("username");
+  std::string teleboyPassword = kodi::addon::GetSettingString("password");
+  HttpClient refreshClient(*m_httpClient);
+  refreshClient.AdoptSession(*m_httpClient);
+  if (Login(refreshClient, teleboyUsername, teleboyPassword, true)) {
+    m_httpClient->AdoptSession(refreshClient);
+    m_sessionStart = std::time(0);
+    kodi::Log(ADDON_LOG_DEBUG, "Session refreshed");
+  } else {
+    kodi::Log(ADDON_LOG_WARNING, "Session refresh failed, keeping the current session");
+    m_sessionStart = std::time(0) - SESSION_REFRESH_INTERVAL + SESSION_REFRESH_RETRY;
+  }
+}
+
+void Session::SetLoginInProgress(bool loginInProgress) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_loginInProgress = loginInProgress;
+  }
+  m_condition.notify_all();
+}
+
+bool Session::WaitForConnection() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_condition.wait_for(lock, std::chrono::seconds(LOGIN_WAIT_SECONDS), [this] {
+    bool loginPending = m_loginInProgress
+        || (!m_isConnected && m_nextLoginAttempt <= std::time(0));
+    return !m_running || !loginPending;
+  });
+  return m_isConnected && !m_loginInProgress;
+}
+
+// A failed refresh must neither touch the state of the running session nor
+// delay a later login, so these are only updated if refresh is false.
+bool Session::Login(HttpClient& httpClient, string u, string p, bool refresh)
 {
-  m_httpClient->ResetHeaders();
-  std::string tbUrl = "https://www.teleboy.ch";
+  httpClient.ResetHeaders();
+  std::string tbUrl = TELEBOY_WEB_URL;
   int statusCode;
-  std::string result = m_httpClient->HttpGet(tbUrl + "/live", statusCode);
+  std::string result = httpClient.HttpGet(tbUrl + "/live", statusCode);
   
   if (statusCode != 200)
   {
-    m_teleBoy->UpdateConnectionState("Not reachable", PVR_CONNECTION_STATE_SERVER_UNREACHABLE, kodi::addon::GetLocalizedString(30104));
-    m_nextLoginAttempt = std::time(0) + 60;
+    UpdateLoginState(refresh, "Not reachable", PVR_CONNECTION_STATE_SERVER_UNREACHABLE, kodi::addon::GetLocalizedString(30104));
+    DelayLogin(refresh, 60);
     return false;
   }
   
   bool isAuthenticated = result.find("setIsAuthenticated(true") != std::string::npos;
   
-  m_httpClient->AddHeader("redirect-limit", "0");
+  httpClient.AddHeader("redirect-limit", "0");
 
   if (!isAuthenticated) {
-    m_nextLoginAttempt = std::time(0) + 60;
+    DelayLogin(refresh, 60);
     kodi::Log(ADDON_LOG_INFO, "Not yet authenticated. Try to login.");
-    m_httpClient->HttpGet(tbUrl + "/login", statusCode);
-    std::string location = m_httpClient->GetLocation();
-    if (location.find("t.teleboy.ch") != string::npos)
+    httpClient.HttpGet(tbUrl + "/login", statusCode);
+    std::string location = httpClient.GetLocation();
+    std::string alternativeUrl = GetAlternativeWebUrl();
+    if (alternativeUrl != tbUrl && location.compare(0, alternativeUrl.size(), alternativeUrl) == 0)
     {
-      kodi::Log(ADDON_LOG_INFO, "Using t.teleboy.ch.");
-      tbUrl = "https://t.teleboy.ch";
-      m_httpClient->HttpGet(tbUrl + "/login", statusCode);
+      kodi::Log(ADDON_LOG_INFO, "Using %s.", alternativeUrl.c_str());
+      tbUrl = alternativeUrl;
+      httpClient.HttpGet(tbUrl + "/login", statusCode);
       if (statusCode >= 400) {
-        m_teleBoy->UpdateConnectionState("Not reachable", PVR_CONNECTION_STATE_SERVER_UNREACHABLE, kodi::addon::GetLocalizedString(30104));
-        m_nextLoginAttempt = std::time(0) + 60;
+        UpdateLoginState(refresh, "Not reachable", PVR_CONNECTION_STATE_SERVER_UNREACHABLE, kodi::addon::GetLocalizedString(30104));
+        DelayLogin(refresh, 60);
         return false;
       }
     }
     
-    m_httpClient->AddHeader("Referer", tbUrl + "/login");
-    result = m_httpClient->HttpPost(tbUrl + "/login_check",
+    httpClient.AddHeader("Referer", tbUrl + "/login");
+    result = httpClient.HttpPost(tbUrl + "/login_check",
         "login=" + Utils::UrlEncode(u) + "&password=" + Utils::UrlEncode(p)
             + "&keep_login=1", statusCode);
     if (statusCode == 429) {
-      m_teleBoy->UpdateConnectionState("Rate limit reached.", PVR_CONNECTION_STATE_ACCESS_DENIED, kodi::addon::GetLocalizedString(30103));
+      UpdateLoginState(refresh, "Rate limit reached.", PVR_CONNECTION_STATE_ACCESS_DENIED, kodi::addon::GetLocalizedString(30103));
       kodi::Log(ADDON_LOG_ERROR, "Rate limit reached.");
-      m_nextLoginAttempt = std::time(0) + 60 * 60 * 2;
+      DelayLogin(refresh, 60 * 60 * 2);
       return false;
     }
     if (statusCode >= 400) {
-      m_teleBoy->UpdateConnectionState("Login failed", PVR_CONNECTION_STATE_ACCESS_DENIED, kodi::addon::GetLocalizedString(30101));
+      UpdateLoginState(refresh, "Login failed", PVR_CONNECTION_STATE_ACCESS_DENIED, kodi::addon::GetLocalizedString(30101));
       kodi::Log(ADDON_LOG_ERROR, "Authentication failed.");
-      m_nextLoginAttempt = std::time(0) + 60 * 60 * 2;
+      DelayLogin(refresh, 60 * 60 * 2);
       return false;
     }
     
-    m_httpClient->ResetHeaders();
-    m_httpClient->AddHeader("redirect-limit", "5");
-    m_httpClient->AddHeader("Referer", tbUrl + "/login");
-    result = m_httpClient->HttpGet(tbUrl, statusCode);
-    m_httpClient->ResetHeaders();
+    httpClient.ResetHeaders();
+    httpClient.AddHeader("redirect-limit", "5");
+    httpClient.AddHeader("Referer", tbUrl + "/login");
+    result = httpClient.HttpGet(tbUrl, statusCode);
+    httpClient.ResetHeaders();
     if (result.empty())
     {
-      m_teleBoy->UpdateConnectionState("Login failed", PVR_CONNECTION_STATE_ACCESS_DENIED, kodi::addon::GetLocalizedString(30101));
+      UpdateLoginState(refresh, "Login failed", PVR_CONNECTION_STATE_ACCESS_DENIED, kodi::addon::GetLocalizedString(30101));
       kodi::Log(ADDON_LOG_ERROR, "Failed to login.");
-      m_nextLoginAttempt = std::time(0) + 60 * 60;
+      DelayLogin(refresh, 60 * 60);
       return false;
     }
   } else {
@@ -141,7 +222,7 @@ bool Session::Login(string u, string p)
   if (pos == std::string::npos || pos1 > pos + 50)
   {
     kodi::Log(ADDON_LOG_ERROR, "No api key found.");
-    m_nextLoginAttempt = std::time(0) + 60 * 60;
+    DelayLogin(refresh, 60 * 60);
     return false;
   }
   size_t endPos = result.find("'", pos1);
@@ -149,16 +230,16 @@ bool Session::Login(string u, string p)
   {
     kodi::Log(ADDON_LOG_DEBUG, "Got HTML body: %s", result.c_str());
     kodi::Log(ADDON_LOG_ERROR, "Received api key is invalid.");
-    m_nextLoginAttempt = std::time(0) + 60 * 60;
+    DelayLogin(refresh, 60 * 60);
     return false;
   }
-  m_httpClient->SetApiKey(result.substr(pos1, endPos - pos1));
+  httpClient.SetApiKey(result.substr(pos1, endPos - pos1));
 
   pos = result.find("setId(");
   if (pos == std::string::npos)
   {
     kodi::Log(ADDON_LOG_ERROR, "No user settings found.");
-    m_nextLoginAttempt = std::time(0) + 60 * 60;
+    DelayLogin(refresh, 60 * 60);
     return false;
   }
   pos += 6;
@@ -167,28 +248,55 @@ bool Session::Login(string u, string p)
   {
     kodi::Log(ADDON_LOG_DEBUG, "Got HTML body: %s", result.c_str());
     kodi::Log(ADDON_LOG_ERROR, "Received userId is invalid.");
-    m_nextLoginAttempt = std::time(0) + 60 * 60;
+    DelayLogin(refresh, 60 * 60);
     return false;
   }
-  m_userId = result.substr(pos, endPos - pos);
-  m_isPlusMember = result.find("setIsPlusMember(1", endPos) != std::string::npos;
-  m_isComfortMember = result.find("setIsComfortMember(1", endPos)
+  std::string userId = result.substr(pos, endPos - pos);
+  bool isPlusMember = result.find("setIsPlusMember(1", endPos) != std::string::npos;
+  bool isComfortMember = result.find("setIsComfortMember(1", endPos)
       != std::string::npos;
-  if (!m_isPlusMember) {
-    kodi::Log(ADDON_LOG_INFO, "Free accounts are not supported.", m_userId.c_str());
-    kodi::QueueNotification(QUEUE_ERROR, "", kodi::addon::GetLocalizedString(30102));
-    m_nextLoginAttempt = std::time(0) + 60 * 60;
+  if (!isPlusMember) {
+    kodi::Log(ADDON_LOG_INFO, "Free accounts are not supported.", userId.c_str());
+    if (!refresh) {
+      kodi::QueueNotification(QUEUE_ERROR, "", kodi::addon::GetLocalizedString(30102));
+    }
+    DelayLogin(refresh, 60 * 60);
     return false;
   }
-  kodi::Log(ADDON_LOG_DEBUG, "Got userId: %s.", m_userId.c_str());
+  kodi::Log(ADDON_LOG_DEBUG, "Got userId: %s.", userId.c_str());
+  // the running session keeps using these, a refresh does not change them
+  if (!refresh) {
+    m_userId = userId;
+    m_isPlusMember = isPlusMember;
+    m_isComfortMember = isComfortMember;
+  }
   
-  m_httpClient->AddHeader("Content-Type", "application/json");
+  httpClient.AddHeader("Content-Type", "application/json");
   return true;
 }
 
+void Session::DelayLogin(bool refresh, time_t delay)
+{
+  if (!refresh) {
+    m_nextLoginAttempt = std::time(0) + delay;
+  }
+}
+
+void Session::UpdateLoginState(bool refresh, const std::string& connectionString,
+    PVR_CONNECTION_STATE newState, const std::string& message)
+{
+  if (!refresh) {
+    m_teleBoy->UpdateConnectionState(connectionString, newState, message);
+  }
+}
+
 void Session::Reset()
 {
-  m_isConnected = false;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isConnected = false;
+  }
+  m_condition.notify_all();
   m_httpClient->ClearSession();
   m_teleBoy->UpdateConnectionState("Teleboy session expired", PVR_CONNECTION_STATE_CONNECTING, "");
 }
@@ -216,3 +324,14 @@ bool Session::VerifySettings() {
 
 void Session::ErrorStatusCode (int statusCode) {
 }
+
+void Session::CircuitStateChanged (bool open) {
+  if (!m_isConnected) {
+    return;
+  }
+  if (open) {
+    m_teleBoy->UpdateConnectionState("Teleboy not reachable", PVR_CONNECTION_STATE_SERVER_UNREACHABLE, kodi::addon::GetLocalizedString(30104));
+  } else {
+    m_teleBoy->UpdateConnectionState("Teleboy connection established", PVR_CONNECTION_STATE_CONNECTED, "");
+  }
+}
@@ -4,6 +4,10 @@
 #include "http/HttpClient.h"
 #include "http/HttpStatusCodeHandler.h"
 #include "Utils.h"
+#include "kodi/addon-instance/PVR.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
 class TeleBoy;
@@ -17,7 +21,9 @@ public:
   void Stop();
   void LoginThread();
   void Reset();
+  bool WaitForConnection();
   void ErrorStatusCode (int statusCode);
+  void CircuitStateChanged (bool open);
   ADDON_STATUS SetSetting(const std::string& settingName, const kodi::addon::CSettingValue& settingValue);
   std::string GetUserId() {
     return m_userId;
@@ -38,7 +44,12 @@ public:
     return m_isConnected;
   }
 private:
-  bool Login(std::string u, std::string p);
+  bool Login(HttpClient& httpClient, std::string u, std::string p, bool refresh);
+  void DelayLogin(bool refresh, time_t delay);
+  void UpdateLoginState(bool refresh, const std::string& connectionString,
+      PVR_CONNECTION_STATE newState, const std::string& message);
+  void RefreshSession();
+  void SetLoginInProgress(bool loginInProgress);
   bool VerifySettings();
   HttpClient* m_httpClient;
   TeleBoy* m_teleBoy;
@@ -48,9 +59,13 @@ private:
   bool m_enableDolby = false;
   bool m_favoritesOnly = false;
   int64_t m_maxRecallSeconds = 60 * 60 * 24 * 7;
-  time_t m_nextLoginAttempt = 0;
-  bool m_isConnected = false;
-  bool m_running = false;
+  std::atomic<time_t> m_nextLoginAttempt = {0};
+  time_t m_sessionStart = 0;
+  std::atomic<bool> m_isConnected = {false};
+  bool m_loginInProgress = false;
+  std::atomic<bool> m_running = {false};
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
   std::thread m_thread;
 };
 
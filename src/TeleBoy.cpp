@@ -1,6 +1,8 @@
 #include "TeleBoy.h"
 #include "md5.h"
+#include "xxhash.h"
 #include "Utils.h"
+#include "http/Cache.h"
 #ifdef TARGET_WINDOWS
 #include "windows.h"
 #endif
@@ -9,6 +11,7 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <list>
 #include <map>
 #include <time.h>
 #include <random>
@@ -25,12 +28,46 @@
 using namespace std;
 using namespace rapidjson;
 
-static const string apiUrl = "https://tv.api.teleboy.ch";
+static const string apiUrl = TELEBOY_API_URL;
+static const string webUrl = TELEBOY_WEB_URL;
+static const time_t prefetchedStreamValidity = 60;
+static const time_t redirectTargetValidity = 120;
+// broadcasts around now which are searched for the current and next ones.
+// The api may match broadcasts by their begin only, so the window reaches
+// back far enough for the current one of long broadcasts like films and sport.
+static const time_t nowNextBefore = 60 * 60 * 6;
+static const time_t nowNextAfter = 60 * 60 * 2;
+// the epg is loaded in aligned slices of this duration
+static const time_t epgSliceDuration = 60 * 60 * 24;
+// broadcasts near the borders of a loaded epg window are never deleted
+static const time_t epgWindowMargin = 60 * 60 * 3;
+// unchanged broadcasts are sent again after this time, in case kodi dropped them
+static const time_t sentEpgTagValidity = 60 * 60 * 12;
+
+// Splits an url into "scheme://host" and the remainder
+static void SplitUrl(const string& url, string& origin, string& path)
+{
+  string::size_type schemeEnd = url.find("://");
+  string::size_type pathBegin = url.find('/', schemeEnd == string::npos ? 0 : schemeEnd + 3);
+  if (pathBegin == string::npos)
+  {
+    origin = url;
+    path = "";
+    return;
+  }
+  origin = url.substr(0, pathBegin);
+  path = url.substr(pathBegin);
+}
 std::mutex TeleBoy::sendEpgToKodiMutex;
 
-bool TeleBoy::ApiGetResult(string content, Document &doc)
+bool TeleBoy::ApiGetResult(const string& content, Document &doc)
 {
-  doc.Parse(content.c_str());
+  return ApiGetResult(string_view(content), doc);
+}
+
+bool TeleBoy::ApiGetResult(string_view content, Document &doc)
+{
+  doc.Parse(content.data(), content.size());
   if (!doc.GetParseError())
   {
     if (doc["success"].GetBool())
@@ -47,7 +84,7 @@ bool TeleBoy::ApiGetResult(string content, Document &doc)
 
 bool TeleBoy::ApiGet(string url, Document &doc, time_t timeout)
 {
-  if (!m_session->IsConnected()) {
+  if (!m_session->WaitForConnection()) {
     return false;
   }
   return ApiGetWithoutConnectedCheck(url, doc, timeout);
@@ -57,18 +94,29 @@ bool TeleBoy::ApiGetWithoutConnectedCheck(string url, Document &doc, time_t time
 {
   string content;
   int statusCode;
-  if (timeout > 0) {
-    content = m_httpClient->HttpGetCached(apiUrl + url, timeout, statusCode);
-  } else {
+  if (timeout <= 0) {
     content = m_httpClient->HttpGet(apiUrl + url, statusCode);
+    return ApiGetResult(content, doc);
   }
-  return ApiGetResult(content, doc);
+  CacheEntry cached;
+  if (m_httpClient->ReadCached(apiUrl + url, cached, statusCode)) {
+    return ApiGetResult(cached.View(), doc);
+  }
+  content = m_httpClient->HttpGet(apiUrl + url, statusCode);
+  bool success = ApiGetResult(content, doc);
+  // a reset session is no reason to block the url
+  if (!success && doc.IsObject() && doc.HasMember("error_code")
+      && doc["error_code"].GetInt() == 10403) {
+    return false;
+  }
+  m_httpClient->CacheResponse(apiUrl + url, content, statusCode, success, timeout);
+  return success;
 }
 
 bool TeleBoy::ApiPost(string url, string postData, Document &doc)
 {
   int statusCode;
-  if (!m_session->IsConnected()) {
+  if (!m_session->WaitForConnection()) {
     return false;
   }
   string content = m_httpClient->HttpPost(apiUrl + url, postData, statusCode);
@@ -78,7 +126,7 @@ bool TeleBoy::ApiPost(string url, string postData, Document &doc)
 bool TeleBoy::ApiDelete(string url, Document &doc)
 {
   int statusCode;
-  if (!m_session->IsConnected()) {
+  if (!m_session->WaitForConnection()) {
     return false;
   }
   string content = m_httpClient->HttpDelete(apiUrl + url, statusCode);
@@ -91,6 +139,11 @@ TeleBoy::TeleBoy()
   m_httpClient = new HttpClient(m_parameterDB);
   m_session = new Session(m_httpClient, this);
   m_httpClient->SetStatusCodeHandler(m_session);
+  // playback should fail fast, background epg loads may wait longer
+  m_httpClient->SetRetryPolicy("/stream/", { 2, 200, 1000 });
+  m_httpClient->SetRetryPolicy("/broadcasts", { 4, 1000, 16000 });
+  m_httpClient->SetRateLimit("", 5, 10);
+  m_httpClient->SetRateLimit("/broadcasts", 2, 6);
   
   UpdateConnectionState("Initializing", PVR_CONNECTION_STATE_CONNECTING, "");
 }
@@ -104,16 +157,24 @@ TeleBoy::~TeleBoy()
   delete m_session;
   delete m_httpClient;
   delete m_parameterDB;
+  Cache::Shutdown();
 }
 
 ADDON_STATUS TeleBoy::Create()
 {
   kodi::Log(ADDON_LOG_DEBUG, "%s - Creating the PVR Teleboy add-on", __FUNCTION__);
+  kodi::Log(ADDON_LOG_INFO, "Using useragent: %s", HttpClient::GetUserAgent().c_str());
+  Cache::SetCapacity(static_cast<uint64_t>(kodi::addon::GetSettingInt("cacheSize", 100)) * 1024 * 1024);
   return m_session->Start();
 }
 
 ADDON_STATUS TeleBoy::SetSetting(const std::string& settingName, const kodi::addon::CSettingValue& settingValue)
 {
+  if (settingName == "cacheSize")
+  {
+    Cache::SetCapacity(static_cast<uint64_t>(settingValue.GetInt()) * 1024 * 1024);
+    return ADDON_STATUS_OK;
+  }
   return m_session->SetSetting(settingName, settingValue);
 }
 
@@ -128,8 +189,23 @@ bool TeleBoy::SessionInitialized()
     updateThreads.emplace_back(new UpdateThread(updateThreads.size(), *this, *m_session));
   }
 
+  {
+    // a new session may come with a new epg on kodi's side
+    std::lock_guard<std::mutex> lock(sendEpgToKodiMutex);
+    sentEpgTags.clear();
+  }
   LoadGenres();
-  return LoadChannels();
+  if (!LoadChannels())
+  {
+    return false;
+  }
+  UpdateThread::LoadNowNext();
+  // fill the cache for the first guide open while nothing else is requested
+  for (int const &cid : sortedChannels)
+  {
+    UpdateThread::WarmUpEpg(cid);
+  }
+  return true;
 }
 
 PVR_ERROR TeleBoy::GetCapabilities(kodi::addon::PVRCapabilities& capabilities)
@@ -178,6 +254,8 @@ void TeleBoy::LoadGenres()
     kodi::Log(ADDON_LOG_ERROR, "Error loading genres.");
     return;
   }
+  // filled aside, the conversions read the genres while a new login loads them
+  map<int, TeleboyGenre> loadedGenres;
   Value& genres = json["data"]["items"];
   for (Value::ConstValueIterator itr1 = genres.Begin();
       itr1 != genres.End(); ++itr1)
@@ -187,7 +265,8 @@ void TeleBoy::LoadGenres()
     int id = genre["id"].GetInt();
     teleboyGenre.name = GetStringOrEmpty(genre, "name");
     teleboyGenre.nameEn = GetStringOrEmpty(genre, "name_en");
-    genresById[id] = teleboyGenre;
+    teleboyGenre.kodiGenre = m_categories.Category(teleboyGenre.nameEn);
+    loadedGenres[id] = teleboyGenre;
 
     if (genre.HasMember("sub_genres")) {
       const Value& subGenres = genre["sub_genres"];
@@ -200,10 +279,13 @@ void TeleBoy::LoadGenres()
         int subId = subGenre["id"].GetInt();
         teleboySubGenre.name = GetStringOrEmpty(subGenre, "name");
         teleboySubGenre.nameEn = GetStringOrEmpty(subGenre, "name_en");
-        genresById[subId] = teleboySubGenre;
+        teleboySubGenre.kodiGenre = m_categories.Category(teleboySubGenre.nameEn);
+        loadedGenres[subId] = teleboySubGenre;
       }
     }
   }
+  std::lock_guard<std::mutex> lock(genresMutex);
+  genresById.swap(loadedGenres);
 }
 
 bool TeleBoy::LoadChannels()
@@ -214,9 +296,11 @@ bool TeleBoy::LoadChannels()
     kodi::Log(ADDON_LOG_ERROR, "Error loading channels.");
     return false;
   }
-  Value& channels = json["data"]["items"];
-  for (Value::ConstValueIterator itr1 = channels.Begin();
-      itr1 != channels.End(); ++itr1)
+  // filled aside and swapped in, a new login replaces the channels of the last one
+  map<int, TeleBoyChannel> channels;
+  Value& stations = json["data"]["items"];
+  for (Value::ConstValueIterator itr1 = stations.Begin();
+      itr1 != stations.End(); ++itr1)
   {
     const Value &c = (*itr1);
     if (!c["has_stream"].GetBool())
@@ -226,9 +310,9 @@ bool TeleBoy::LoadChannels()
     TeleBoyChannel channel;
     channel.id = c["id"].GetInt();
     channel.name = GetStringOrEmpty(c, "name");
-    channel.logoPath = "https://www.teleboy.ch/assets/stations/"
+    channel.logoPath = webUrl + "/assets/stations/"
         + to_string(channel.id) + "/icon320_dark.png";
-    channelsById[channel.id] = channel;
+    channels[channel.id] = channel;
   }
 
   if (!ApiGetWithoutConnectedCheck("/users/" + m_session->GetUserId() + "/stations", json, 3600))
@@ -236,16 +320,19 @@ bool TeleBoy::LoadChannels()
     kodi::Log(ADDON_LOG_ERROR, "Error loading sorted channels.");
     return false;
   }
-  channels = json["data"]["items"];
-  for (Value::ConstValueIterator itr1 = channels.Begin();
-      itr1 != channels.End(); ++itr1)
+  vector<int> sorted;
+  Value& userStations = json["data"]["items"];
+  for (Value::ConstValueIterator itr1 = userStations.Begin();
+      itr1 != userStations.End(); ++itr1)
   {
     int cid = (*itr1).GetInt();
-    if (channelsById.find(cid) != channelsById.end())
+    if (channels.find(cid) != channels.end())
     {
-      sortedChannels.push_back(cid);
+      sorted.push_back(cid);
     }
   }
+  channelsById.swap(channels);
+  sortedChannels.swap(sorted);
   return true;
 }
 
@@ -273,11 +360,18 @@ PVR_ERROR TeleBoy::GetChannels(bool radio, kodi::addon::PVRChannelsResultSet& re
   }
 
   int channelNum = 0;
-  for (int const &cid : sortedChannels)
+  for (int const &cid : GetChannelOrder())
   {
     channelNum++;
     TransferChannel(results, channelsById[cid], channelNum);
   }
+  return PVR_ERROR_NO_ERROR;
+}
+
+// The channels in the order they are numbered in kodi
+vector<int> TeleBoy::GetChannelOrder()
+{
+  vector<int> channels = sortedChannels;
   if (!m_session->GetFavoritesOnly())
   {
     for (auto const &item : channelsById)
@@ -287,11 +381,10 @@ PVR_ERROR TeleBoy::GetChannels(bool radio, kodi::addon::PVRChannelsResultSet& re
       {
         continue;
       }
-      channelNum++;
-      TransferChannel(results, item.second, channelNum);
+      channels.push_back(item.first);
     }
   }
-  return PVR_ERROR_NO_ERROR;
+  return channels;
 }
 
 void TeleBoy::TransferChannel(kodi::addon::PVRChannelsResultSet& results, TeleBoyChannel channel,
@@ -341,37 +434,144 @@ PVR_ERROR TeleBoy::SetStreamProperties(std::vector<kodi::addon::PVRStreamPropert
 
 PVR_ERROR TeleBoy::GetChannelStreamProperties(const kodi::addon::PVRChannel& channel, std::vector<kodi::addon::PVRStreamProperty>& properties)
 {
-  if (!m_session->IsConnected()) {
+  if (!m_session->WaitForConnection()) {
     return PVR_ERROR_SERVER_ERROR;
   }
 
+  int uniqueChannelId = channel.GetUniqueId();
+  PVR_ERROR ret = PVR_ERROR_NO_ERROR;
+  if (!TakePrefetchedStream(uniqueChannelId, properties))
+  {
+    ret = GetLiveStreamProperties(uniqueChannelId, properties);
+  }
+  if (ret == PVR_ERROR_NO_ERROR)
+  {
+    PrefetchAdjacentChannels(uniqueChannelId);
+  }
+  return ret;
+}
+
+PVR_ERROR TeleBoy::GetLiveStreamProperties(int uniqueChannelId,
+    std::vector<kodi::addon::PVRStreamProperty>& properties)
+{
   Document json;
   if (!ApiGet(
-      "/users/" + m_session->GetUserId() + "/stream/live/" + to_string(channel.GetUniqueId())
+      "/users/" + m_session->GetUserId() + "/stream/live/" + to_string(uniqueChannelId)
           + "?expand=primary_image,flags&https=1" + GetStreamParameters(), json, 0))
   {
     kodi::Log(ADDON_LOG_ERROR, "Error getting live stream url for channel %i.",
-        channel.GetUniqueId());
+        uniqueChannelId);
     return PVR_ERROR_FAILED;
   }
   const Value& stream = json["data"]["stream"];
   return SetStreamProperties(properties, stream, true);
+}
+
+bool TeleBoy::TakePrefetchedStream(int uniqueChannelId,
+    std::vector<kodi::addon::PVRStreamProperty>& properties)
+{
+  std::lock_guard<std::mutex> lock(prefetchedStreamsMutex);
+  auto prefetched = prefetchedStreams.find(uniqueChannelId);
+  if (prefetched == prefetchedStreams.end() || prefetched->second.pending)
+  {
+    return false;
+  }
+  bool valid = prefetched->second.validUntil >= time(nullptr);
+  if (valid)
+  {
+    kodi::Log(ADDON_LOG_DEBUG, "Using prefetched stream for channel %i.", uniqueChannelId);
+    properties = std::move(prefetched->second.properties);
+  }
+  prefetchedStreams.erase(prefetched);
+  return valid;
+}
 
+void TeleBoy::PrefetchAdjacentChannels(int uniqueChannelId)
+{
+  vector<int> channels = GetChannelOrder();
+  auto current = std::find(channels.begin(), channels.end(), uniqueChannelId);
+  if (current == channels.end() || channels.size() < 2)
+  {
+    return;
+  }
+  auto next = current + 1 == channels.end() ? channels.begin() : current + 1;
+  auto previous = current == channels.begin() ? channels.end() - 1 : current - 1;
+  UpdateThread::PrefetchStream(*next);
+  if (previous != next)
+  {
+    UpdateThread::PrefetchStream(*previous);
+  }
+}
+
+void TeleBoy::PrefetchChannelStream(int uniqueChannelId)
+{
+  time_t currentTime = time(nullptr);
+  {
+    std::lock_guard<std::mutex> lock(prefetchedStreamsMutex);
+    for (auto it = prefetchedStreams.begin(); it != prefetchedStreams.end();)
+    {
+      if (!it->second.pending && it->second.validUntil < currentTime)
+      {
+        it = prefetchedStreams.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+    if (prefetchedStreams.find(uniqueChannelId) != prefetchedStreams.end())
+    {
+      return;
+    }
+    // keeps other update threads from fetching the same stream
+    prefetchedStreams[uniqueChannelId] = { {}, 0, true };
+  }
+
+  PrefetchedStream prefetched;
+  bool success = GetLiveStreamProperties(uniqueChannelId, prefetched.properties)
+      == PVR_ERROR_NO_ERROR;
+  prefetched.validUntil = time(nullptr) + prefetchedStreamValidity;
+  prefetched.pending = false;
+
+  std::lock_guard<std::mutex> lock(prefetchedStreamsMutex);
+  if (!success)
+  {
+    prefetchedStreams.erase(uniqueChannelId);
+    return;
+  }
+  kodi::Log(ADDON_LOG_DEBUG, "Prefetched stream for channel %i.", uniqueChannelId);
+  prefetchedStreams[uniqueChannelId] = std::move(prefetched);
 }
 
 string TeleBoy::FollowRedirect(string url)
 {
+  string cachedUrl = GetCachedRedirect(url);
+  if (!cachedUrl.empty())
+  {
+    kodi::Log(ADDON_LOG_DEBUG, "Final url (cached) : %s.", cachedUrl.c_str());
+    return cachedUrl;
+  }
+
   Curl curl;
   curl.AddHeader("redirect-limit", "0");
   string currUrl = url;
   for (int i = 0; i < 5; i++)
   {
-    int statusCode;
-    curl.Get(currUrl, statusCode);
-    string nextUrl = curl.GetLocation();
-    if (nextUrl.empty())
+    int statusCode = -1;
+    curl.GetHeaders(currUrl, statusCode);
+    if (statusCode >= 200 && statusCode < 300)
     {
       kodi::Log(ADDON_LOG_DEBUG, "Final url : %s.", currUrl.c_str());
+      CacheRedirect(url, currUrl);
+      return currUrl;
+    }
+    string nextUrl = curl.GetLocation();
+    if (statusCode < 300 || statusCode >= 400 || nextUrl.empty())
+    {
+      // the location may be left from the previous hop
+      kodi::Log(ADDON_LOG_INFO, "Following redirects failed at %s (%i).", currUrl.c_str(),
+          statusCode);
+      ForgetRedirects(currUrl);
       return currUrl;
     }
     kodi::Log(ADDON_LOG_DEBUG, "Redirected to : %s.", nextUrl.c_str());
@@ -380,6 +580,89 @@ string TeleBoy::FollowRedirect(string url)
   return currUrl;
 }
 
+string TeleBoy::GetCachedRedirect(const string& url)
+{
+  string origin, path;
+  SplitUrl(url, origin, path);
+  time_t currentTime = time(nullptr);
+
+  std::lock_guard<std::mutex> lock(redirectTargetsMutex);
+  auto target = redirectTargets.find(url);
+  if (target != redirectTargets.end() && target->second.validUntil >= currentTime)
+  {
+    return target->second.target;
+  }
+  // redirects which only move to another host apply to all urls of the origin
+  target = redirectTargets.find(origin);
+  if (target != redirectTargets.end() && target->second.validUntil >= currentTime)
+  {
+    return target->second.target + path;
+  }
+  return "";
+}
+
+// Drops the cached redirects to or from the origin of a url which failed, so
+// that one bad hop does not break all urls of the origin until they expire.
+void TeleBoy::ForgetRedirects(const string& url)
+{
+  string origin, path;
+  SplitUrl(url, origin, path);
+
+  std::lock_guard<std::mutex> lock(redirectTargetsMutex);
+  for (auto it = redirectTargets.begin(); it != redirectTargets.end();)
+  {
+    string targetOrigin, targetPath;
+    SplitUrl(it->second.target, targetOrigin, targetPath);
+    string keyOrigin, keyPath;
+    SplitUrl(it->first, keyOrigin, keyPath);
+    if (targetOrigin == origin || keyOrigin == origin)
+    {
+      it = redirectTargets.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+void TeleBoy::CacheRedirect(const string& url, const string& target)
+{
+  if (url == target)
+  {
+    return;
+  }
+  string origin, path, targetOrigin, targetPath;
+  SplitUrl(url, origin, path);
+  SplitUrl(target, targetOrigin, targetPath);
+  time_t currentTime = time(nullptr);
+
+  std::lock_guard<std::mutex> lock(redirectTargetsMutex);
+  for (auto it = redirectTargets.begin(); it != redirectTargets.end();)
+  {
+    if (it->second.validUntil < currentTime)
+    {
+      it = redirectTargets.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  RedirectTarget redirectTarget;
+  redirectTarget.validUntil = currentTime + redirectTargetValidity;
+  if (path == targetPath)
+  {
+    redirectTarget.target = targetOrigin;
+    redirectTargets[origin] = redirectTarget;
+  }
+  else
+  {
+    redirectTarget.target = target;
+    redirectTargets[url] = redirectTarget;
+  }
+}
+
 PVR_ERROR TeleBoy::GetEPGForChannel(int channelUid, time_t start, time_t end, kodi::addon::PVREPGTagsResultSet& results)
 {
   UpdateThread::LoadEpg(channelUid, start, end);
@@ -388,85 +671,415 @@ PVR_ERROR TeleBoy::GetEPGForChannel(int channelUid, time_t start, time_t end, ko
 
 void TeleBoy::GetEPGForChannelAsync(int uniqueChannelId, time_t iStart,
     time_t iEnd)
+{
+  time_t windowStart = iStart - iStart % epgSliceDuration;
+  if (!LoadMissingEpgSlices(uniqueChannelId, windowStart, iEnd))
+  {
+    return;
+  }
+  time_t windowEnd = windowStart;
+  std::set<unsigned> broadcastIds;
+  bool complete = true;
+  do
+  {
+    if (!LoadEpgSlice(uniqueChannelId, windowEnd, &broadcastIds))
+    {
+      complete = false;
+    }
+    windowEnd += epgSliceDuration;
+  } while (windowEnd < iEnd);
+
+  if (!complete)
+  {
+    return;
+  }
+  // Broadcasts close to the borders are kept, in case the api applies
+  // another time zone.
+  std::lock_guard<std::mutex> lock(sendEpgToKodiMutex);
+  DeleteMissingEpgTags(uniqueChannelId, windowStart + epgWindowMargin,
+      windowEnd - epgWindowMargin, broadcastIds);
+}
+
+// Loads the broadcasts of a channel for one slice of the epg. Slices are
+// aligned, so that their urls and cache entries do not depend on the window
+// kodi asks for. The broadcasts are passed to kodi unless broadcastIds is
+// null, which only fills the cache.
+bool TeleBoy::LoadEpgSlice(int uniqueChannelId, time_t sliceStart,
+    std::set<unsigned>* broadcastIds)
 {
   int totals = -1;
   int sum = 0;
   while (totals == -1 || sum < totals)
   {
     Document json;
-    if (!ApiGet(
-        "/users/" + m_session->GetUserId() + "/broadcasts?begin=" + FormatDate(iStart)
-            + "+00:00:00&end=" + FormatDate(iEnd + 60 * 60 * 24) + "+00:00:00&expand=logos&limit=500&skip="
-            + to_string(sum) + "&sort=station&station="
-            + to_string(uniqueChannelId), json, 60*60*24))
+    if (!ApiGet(GetBroadcastsUrl(uniqueChannelId, sliceStart, sum), json, 60*60*24))
     {
       kodi::Log(ADDON_LOG_ERROR, "Error getting epg for channel %i.",
           uniqueChannelId);
-      return;
+      return false;
     }
     totals = json["data"]["total"].GetInt();
     const Value& items = json["data"]["items"];
+    if (items.Empty())
+    {
+      break;
+    }
+    sum += items.Size();
+    if (!broadcastIds)
+    {
+      continue;
+    }
 
     std::lock_guard<std::mutex> lock(sendEpgToKodiMutex);
 
     for (Value::ConstValueIterator itr1 = items.Begin(); itr1 != items.End();
         ++itr1)
+    {
+      broadcastIds->insert((*itr1)["id"].GetInt());
+      TransferEpgTag(*itr1, uniqueChannelId);
+    }
+    kodi::Log(ADDON_LOG_DEBUG, "Loaded %i of %i epg entries for channel %i.", sum,
+        totals, uniqueChannelId);
+  }
+  return true;
+}
+
+// Loads runs of adjacent slices which are not cached yet with one request per
+// run and caches the broadcasts per slice, so a window costs about one request
+// instead of one per slice. Single missing slices are left to LoadEpgSlice.
+bool TeleBoy::LoadMissingEpgSlices(int uniqueChannelId, time_t windowStart,
+    time_t windowEnd)
+{
+  time_t runStart = windowStart;
+  int runLength = 0;
+  for (time_t sliceStart = windowStart;; sliceStart += epgSliceDuration)
+  {
+    if (sliceStart < windowEnd)
+    {
+      CacheEntry cached;
+      int statusCode;
+      if (!m_httpClient->ReadCached(apiUrl + GetBroadcastsUrl(uniqueChannelId, sliceStart, 0),
+          cached, statusCode))
+      {
+        if (runLength == 0)
+        {
+          runStart = sliceStart;
+        }
+        runLength++;
+        continue;
+      }
+    }
+    if (runLength > 1 && !LoadEpgSlices(uniqueChannelId, runStart, runLength))
+    {
+      return false;
+    }
+    runLength = 0;
+    if (sliceStart >= windowEnd)
+    {
+      return true;
+    }
+  }
+}
+
+// Loads the broadcasts of sliceCount adjacent slices with one request and
+// caches them under the url of the slice they begin in, as if each slice was
+// loaded on its own.
+bool TeleBoy::LoadEpgSlices(int uniqueChannelId, time_t firstSliceStart, int sliceCount)
+{
+  vector<string> sliceItems(sliceCount);
+  vector<int> sliceTotals(sliceCount, 0);
+  int totals = -1;
+  int sum = 0;
+  while (totals == -1 || sum < totals)
+  {
+    Document json;
+    if (!ApiGet(GetBroadcastsUrl(uniqueChannelId, firstSliceStart, sum, sliceCount), json, 0))
+    {
+      kodi::Log(ADDON_LOG_ERROR, "Error getting epg for channel %i.",
+          uniqueChannelId);
+      return false;
+    }
+    totals = json["data"]["total"].GetInt();
+    const Value& items = json["data"]["items"];
+    if (items.Empty())
+    {
+      break;
+    }
+    sum += items.Size();
+    for (Value::ConstValueIterator itr1 = items.Begin(); itr1 != items.End();
+        ++itr1)
+    {
+      time_t begin = Utils::StringToTime(GetStringOrEmpty(*itr1, "begin"));
+      int slice = begin < firstSliceStart ? 0
+          : std::min<int>((begin - firstSliceStart) / epgSliceDuration, sliceCount - 1);
+      StringBuffer buffer;
+      Writer<StringBuffer> writer(buffer);
+      itr1->Accept(writer);
+      if (sliceTotals[slice]++ > 0)
+      {
+        sliceItems[slice] += ',';
+      }
+      sliceItems[slice].append(buffer.GetString(), buffer.GetSize());
+    }
+  }
+  for (int slice = 0; slice < sliceCount; slice++)
+  {
+    time_t sliceStart = firstSliceStart + slice * epgSliceDuration;
+    string content = "{\"success\":true,\"status\":200,\"data\":{\"total\":"
+        + to_string(sliceTotals[slice]) + ",\"items\":[" + sliceItems[slice] + "]}}";
+    m_httpClient->CacheResponse(apiUrl + GetBroadcastsUrl(uniqueChannelId, sliceStart, 0),
+        content, 200, true, 60*60*24);
+  }
+  kodi::Log(ADDON_LOG_DEBUG, "Loaded %i epg entries of %i slices for channel %i.", sum,
+      sliceCount, uniqueChannelId);
+  return true;
+}
+
+// Removes broadcasts from kodi, which were sent before but are no longer
+// part of the given window.
+void TeleBoy::DeleteMissingEpgTags(int uniqueChannelId, time_t windowStart,
+    time_t windowEnd, const std::set<unsigned>& broadcastIds)
+{
+  auto channel = sentEpgTags.find(uniqueChannelId);
+  if (channel == sentEpgTags.end())
+  {
+    return;
+  }
+  // kodi drops old broadcasts itself
+  time_t expired = time(nullptr) - (std::max(EpgMaxPastDays(), 0) + 1) * 60 * 60 * 24;
+  int deleted = 0;
+  auto& sentTags = channel->second;
+  for (auto it = sentTags.begin(); it != sentTags.end();)
+  {
+    time_t startTime = it->second.startTime;
+    if (startTime < expired)
+    {
+      it = sentTags.erase(it);
+      continue;
+    }
+    if (startTime < windowStart || startTime >= windowEnd
+        || broadcastIds.find(it->first) != broadcastIds.end())
+    {
+      ++it;
+      continue;
+    }
+    kodi::addon::PVREPGTag tag;
+    tag.SetUniqueBroadcastId(it->first);
+    tag.SetUniqueChannelId(uniqueChannelId);
+    EpgEventStateChange(tag, EPG_EVENT_DELETED);
+    it = sentTags.erase(it);
+    deleted++;
+  }
+  if (deleted > 0)
+  {
+    kodi::Log(ADDON_LOG_DEBUG, "Deleted %i epg entries of channel %i.", deleted,
+        uniqueChannelId);
+  }
+}
+
+uint64_t TeleBoy::GetEpgFingerprint(const Value& item)
+{
+  static const char* const fields[] = { "title", "begin", "end", "headline",
+      "short_description", "original_title", "subtitle" };
+  std::string content;
+  for (const char* field : fields)
+  {
+    content += GetStringOrEmpty(item, field);
+    content += '\x1f';
+  }
+  static const char* const numberFields[] = { "year", "serie_season", "serie_episode",
+      "genre_id" };
+  for (const char* field : numberFields)
+  {
+    Value::ConstMemberIterator member = item.FindMember(field);
+    if (member != item.MemberEnd() && member->value.IsInt())
+    {
+      content += to_string(member->value.GetInt());
+    }
+    content += '\x1f';
+  }
+  return XXHash64(content.data(), content.length());
+}
+
+// Sends a broadcast to kodi, unless kodi already has it in the same version.
+// Must be called with sendEpgToKodiMutex held.
+void TeleBoy::TransferEpgTag(const Value& item, int uniqueChannelId)
+{
+  unsigned broadcastId = item["id"].GetInt();
+  uint64_t fingerprint = GetEpgFingerprint(item);
+  time_t startTime = Utils::StringToTime(GetStringOrEmpty(item, "begin"));
+  time_t now = time(nullptr);
+  auto& sentTags = sentEpgTags[uniqueChannelId];
+  auto sent = sentTags.find(broadcastId);
+  EPG_EVENT_STATE state = EPG_EVENT_CREATED;
+  if (sent != sentTags.end())
+  {
+    if (sent->second.fingerprint == fingerprint
+        && sent->second.sentAt + sentEpgTagValidity > now)
+    {
+      return;
+    }
+    state = EPG_EVENT_UPDATED;
+  }
+  sentTags[broadcastId] = { fingerprint, startTime, now };
+
+  kodi::addon::PVREPGTag tag;
+
+  tag.SetUniqueBroadcastId(broadcastId);
+  tag.SetTitle(GetStringOrEmpty(item, "title"));
+  tag.SetUniqueChannelId(uniqueChannelId);
+  tag.SetStartTime(startTime);
+  tag.SetEndTime(Utils::StringToTime(GetStringOrEmpty(item, "end")));
+  tag.SetPlotOutline(GetStringOrEmpty(item, "headline"));
+  tag.SetPlot(GetStringOrEmpty(item, "short_description"));
+  tag.SetOriginalTitle(GetStringOrEmpty(item, "original_title"));
+  tag.SetCast(""); /* not supported */
+  tag.SetDirector(""); /*SA not supported */
+  tag.SetWriter(""); /* not supported */
+  tag.SetYear(item.HasMember("year") ? item["year"].GetInt() : 0);
+  tag.SetIMDBNumber(""); /* not supported */
+  tag.SetIconPath(""); /* not supported */
+  tag.SetParentalRating(0); /* not supported */
+  tag.SetStarRating(0); /* not supported */
+  tag.SetSeriesNumber(
+      item.HasMember("serie_season") ? item["serie_season"].GetInt() : EPG_TAG_INVALID_SERIES_EPISODE);
+  tag.SetEpisodeNumber(
+      item.HasMember("serie_episode") ? item["serie_episode"].GetInt() : EPG_TAG_INVALID_SERIES_EPISODE);
+  tag.SetEpisodePartNumber(EPG_TAG_INVALID_SERIES_EPISODE); /* not supported */
+  tag.SetEpisodeName(GetStringOrEmpty(item, "subtitle"));
+  if (item.HasMember("genre_id")) {
+    TeleboyGenre genre = GetGenre(item["genre_id"].GetInt());
+    int kodiGenre = genre.kodiGenre;
+    if (kodiGenre == 0) {
+      tag.SetGenreType(EPG_GENRE_USE_STRING);
+      tag.SetGenreSubType(0);
+      tag.SetGenreDescription(genre.name);
+    } else {
+      tag.SetGenreSubType(kodiGenre & 0x0F);
+      tag.SetGenreType(kodiGenre & 0xF0);
+    }
+  }
+  tag.SetFlags(EPG_TAG_FLAG_UNDEFINED);
+
+  EpgEventStateChange(tag, state);
+}
+
+// Sends the current and the next broadcast of all channels to kodi, so the
+// channel list shows programme info before the full epg is loaded.
+void TeleBoy::LoadNowNext()
+{
+  time_t now = time(nullptr);
+  std::map<int, std::pair<const Value*, const Value*>> nowNext;
+  // the found broadcasts point into the pages
+  std::list<Document> pages;
+  int totals = -1;
+  int sum = 0;
+  while (totals == -1 || sum < totals)
+  {
+    pages.emplace_back();
+    Document& json = pages.back();
+    if (!ApiGet("/users/" + m_session->GetUserId() + "/broadcasts?begin="
+        + FormatDateTime(now - nowNextBefore) + "&end=" + FormatDateTime(now + nowNextAfter)
+        + "&limit=500&skip=" + to_string(sum) + "&sort=station", json, 0))
+    {
+      kodi::Log(ADDON_LOG_ERROR, "Error getting current broadcasts.");
+      break;
+    }
+    totals = json["data"]["total"].GetInt();
+    const Value& items = json["data"]["items"];
+    if (items.Empty())
+    {
+      break;
+    }
+    for (Value::ConstValueIterator itr1 = items.Begin(); itr1 != items.End(); ++itr1)
     {
       const Value& item = (*itr1);
       sum++;
-      kodi::addon::PVREPGTag tag;
-
-      tag.SetUniqueBroadcastId(item["id"].GetInt());
-      tag.SetTitle(GetStringOrEmpty(item, "title"));
-      tag.SetUniqueChannelId(uniqueChannelId);
-      tag.SetStartTime(Utils::StringToTime(GetStringOrEmpty(item, "begin")));
-      tag.SetEndTime(Utils::StringToTime(GetStringOrEmpty(item, "end")));
-      tag.SetPlotOutline(GetStringOrEmpty(item, "headline"));
-      tag.SetPlot(GetStringOrEmpty(item, "short_description"));
-      tag.SetOriginalTitle(GetStringOrEmpty(item, "original_title"));
-      tag.SetCast(""); /* not supported */
-      tag.SetDirector(""); /*SA not supported */
-      tag.SetWriter(""); /* not supported */
-      tag.SetYear(item.HasMember("year") ? item["year"].GetInt() : 0);
-      tag.SetIMDBNumber(""); /* not supported */
-      tag.SetIconPath(""); /* not supported */
-      tag.SetParentalRating(0); /* not supported */
-      tag.SetStarRating(0); /* not supported */
-      tag.SetSeriesNumber(
-          item.HasMember("serie_season") ? item["serie_season"].GetInt() : EPG_TAG_INVALID_SERIES_EPISODE);
-      tag.SetEpisodeNumber(
-          item.HasMember("serie_episode") ? item["serie_episode"].GetInt() : EPG_TAG_INVALID_SERIES_EPISODE);
-      tag.SetEpisodePartNumber(EPG_TAG_INVALID_SERIES_EPISODE); /* not supported */
-      tag.SetEpisodeName(GetStringOrEmpty(item, "subtitle"));
-      if (item.HasMember("genre_id")) {
-        int genreId = item["genre_id"].GetInt();
-        TeleboyGenre genre = genresById[genreId];
-        int kodiGenre = m_categories.Category(genre.nameEn);
-        if (kodiGenre == 0) {
-          tag.SetGenreType(EPG_GENRE_USE_STRING);
-          tag.SetGenreSubType(0);
-          tag.SetGenreDescription(genre.name);
-        } else {
-          tag.SetGenreSubType(kodiGenre & 0x0F);
-          tag.SetGenreType(kodiGenre & 0xF0);
-        }
+      if (!item.HasMember("station_id"))
+      {
+        continue;
+      }
+      time_t begin = Utils::StringToTime(GetStringOrEmpty(item, "begin"));
+      time_t end = Utils::StringToTime(GetStringOrEmpty(item, "end"));
+      auto& slots = nowNext[item["station_id"].GetInt()];
+      if (begin <= now && end > now)
+      {
+        slots.first = &item;
       }
-      tag.SetFlags(EPG_TAG_FLAG_UNDEFINED);
+      else if (begin > now && (slots.second == nullptr || begin
+          < Utils::StringToTime(GetStringOrEmpty(*slots.second, "begin"))))
+      {
+        slots.second = &item;
+      }
+    }
+  }
 
-      EpgEventStateChange(tag, EPG_EVENT_CREATED);
+  std::lock_guard<std::mutex> lock(sendEpgToKodiMutex);
+  int count = 0;
+  for (auto const &slots : nowNext)
+  {
+    if (channelsById.find(slots.first) == channelsById.end())
+    {
+      continue;
+    }
+    if (slots.second.first)
+    {
+      TransferEpgTag(*slots.second.first, slots.first);
+      count++;
+    }
+    if (slots.second.second)
+    {
+      TransferEpgTag(*slots.second.second, slots.first);
+      count++;
     }
-    kodi::Log(ADDON_LOG_DEBUG, "Loaded %i of %i epg entries for channel %i.", sum,
-        totals, uniqueChannelId);
   }
-  return;
+  kodi::Log(ADDON_LOG_DEBUG, "Loaded %i current and next broadcasts.", count);
 }
 
-string TeleBoy::FormatDate(time_t dateTime)
+// Loads the slices of the window kodi requests on its first epg update into
+// the cache without passing them to kodi.
+void TeleBoy::WarmUpEpg(int uniqueChannelId)
+{
+  int pastDays = EpgMaxPastDays();
+  int futureDays = EpgMaxFutureDays();
+  if (pastDays < 0 || futureDays < 0)
+  {
+    // unlimited time frame, the requested window is unknown
+    return;
+  }
+  time_t now = time(nullptr);
+  time_t iStart = now - pastDays * 60 * 60 * 24;
+  time_t iEnd = now + futureDays * 60 * 60 * 24;
+  if (!LoadMissingEpgSlices(uniqueChannelId, iStart - iStart % epgSliceDuration, iEnd))
+  {
+    kodi::Log(ADDON_LOG_DEBUG, "Warm-up of epg for channel %i failed.", uniqueChannelId);
+    return;
+  }
+  for (time_t sliceStart = iStart - iStart % epgSliceDuration; sliceStart < iEnd;
+      sliceStart += epgSliceDuration)
+  {
+    if (!LoadEpgSlice(uniqueChannelId, sliceStart, nullptr))
+    {
+      kodi::Log(ADDON_LOG_DEBUG, "Warm-up of epg for channel %i failed.", uniqueChannelId);
+      return;
+    }
+  }
+}
+
+string TeleBoy::GetBroadcastsUrl(int uniqueChannelId, time_t sliceStart, int skip,
+    int sliceCount)
+{
+  return "/users/" + m_session->GetUserId() + "/broadcasts?begin=" + FormatDateTime(sliceStart)
+      + "&end=" + FormatDateTime(sliceStart + sliceCount * epgSliceDuration) + "&expand=logos&limit=500&skip="
+      + to_string(skip) + "&sort=station&station=" + to_string(uniqueChannelId);
+}
+
+string TeleBoy::FormatDateTime(time_t dateTime)
 {
   char buff[20];
   struct tm tm;
   gmtime_r(&dateTime, &tm);
-  strftime(buff, 20, "%Y-%m-%d", &tm);
+  strftime(buff, 20, "%Y-%m-%d+%H:%M:%S", &tm);
   return buff;
 }
 
@@ -478,7 +1091,7 @@ PVR_ERROR TeleBoy::GetRecordingsAmount(bool deleted, int& amount)
 
 PVR_ERROR TeleBoy::DeleteRecording(const kodi::addon::PVRRecording& recording)
 {
-  if (!m_session->IsConnected()) {
+  if (!m_session->WaitForConnection()) {
     return PVR_ERROR_SERVER_ERROR;
   }
   Document doc;
@@ -515,54 +1128,61 @@ PVR_ERROR TeleBoy::GetRecordings(bool deleted, kodi::addon::PVRRecordingsResultS
     for (Value::ConstValueIterator itr1 = items.Begin(); itr1 != items.End();
         ++itr1)
     {
-      const Value& item = (*itr1);
       sum++;
-
-      kodi::addon::PVRRecording tag;
-
-      tag.SetIsDeleted(false);
-      tag.SetRecordingId(to_string(item["id"].GetInt()));
-      tag.SetTitle(GetStringOrEmpty(item, "title"));
-      tag.SetEpisodeName(GetStringOrEmpty(item, "subtitle"));      
-      tag.SetPlot(GetStringOrEmpty(item, "description"));
-      tag.SetPlotOutline(GetStringOrEmpty(item, "short_description"));
-      tag.SetChannelUid(item["station_id"].GetInt());
-      tag.SetIconPath(channelsById[tag.GetChannelUid()].logoPath);
-      tag.SetChannelName(channelsById[tag.GetChannelUid()].name);
-      tag.SetRecordingTime(Utils::StringToTime(GetStringOrEmpty(item, "begin")));
-      time_t endTime = Utils::StringToTime(GetStringOrEmpty(item, "end"));
-      tag.SetDuration(endTime - tag.GetRecordingTime());
-      tag.SetEPGEventId(item["id"].GetInt());
-      if (item.HasMember("serie_season")) {
-        tag.SetSeriesNumber(item["serie_season"].GetInt());
-        tag.SetDirectory(tag.GetTitle());
-      }
-      if (item.HasMember("serie_episode")) {
-        tag.SetEpisodeNumber(item["serie_episode"].GetInt());
-      }
-      if (item.HasMember("genre_id")) {
-        int genreId = item["genre_id"].GetInt();
-        TeleboyGenre genre = genresById[genreId];
-        int kodiGenre = m_categories.Category(genre.nameEn);
-        if (kodiGenre == 0) {
-          tag.SetGenreType(EPG_GENRE_USE_STRING);
-          tag.SetGenreSubType(0);
-          tag.SetGenreDescription(genre.name);
-        } else {
-          tag.SetGenreSubType(kodiGenre & 0x0F);
-          tag.SetGenreType(kodiGenre & 0xF0);
-        }
-      }
-
-      results.Add(tag);
+      TransferRecording(*itr1, results);
     }
   }
   return PVR_ERROR_NO_ERROR;
 }
 
+void TeleBoy::TransferRecording(const Value& item,
+    kodi::addon::PVRRecordingsResultSet& results)
+{
+  kodi::addon::PVRRecording tag;
+
+  tag.SetIsDeleted(false);
+  tag.SetRecordingId(to_string(item["id"].GetInt()));
+  tag.SetTitle(GetStringOrEmpty(item, "title"));
+  tag.SetEpisodeName(GetStringOrEmpty(item, "subtitle"));      
+  tag.SetPlot(GetStringOrEmpty(item, "description"));
+  tag.SetPlotOutline(GetStringOrEmpty(item, "short_description"));
+  tag.SetChannelUid(item["station_id"].GetInt());
+  auto channel = channelsById.find(tag.GetChannelUid());
+  if (channel != channelsById.end())
+  {
+    tag.SetIconPath(channel->second.logoPath);
+    tag.SetChannelName(channel->second.name);
+  }
+  tag.SetRecordingTime(Utils::StringToTime(GetStringOrEmpty(item, "begin")));
+  time_t endTime = Utils::StringToTime(GetStringOrEmpty(item, "end"));
+  tag.SetDuration(endTime - tag.GetRecordingTime());
+  tag.SetEPGEventId(item["id"].GetInt());
+  if (item.HasMember("serie_season")) {
+    tag.SetSeriesNumber(item["serie_season"].GetInt());
+    tag.SetDirectory(tag.GetTitle());
+  }
+  if (item.HasMember("serie_episode")) {
+    tag.SetEpisodeNumber(item["serie_episode"].GetInt());
+  }
+  if (item.HasMember("genre_id")) {
+    TeleboyGenre genre = GetGenre(item["genre_id"].GetInt());
+    int kodiGenre = genre.kodiGenre;
+    if (kodiGenre == 0) {
+      tag.SetGenreType(EPG_GENRE_USE_STRING);
+      tag.SetGenreSubType(0);
+      tag.SetGenreDescription(genre.name);
+    } else {
+      tag.SetGenreSubType(kodiGenre & 0x0F);
+      tag.SetGenreType(kodiGenre & 0xF0);
+    }
+  }
+
+  results.Add(tag);
+}
+
 PVR_ERROR TeleBoy::GetRecordingStreamProperties(const kodi::addon::PVRRecording& recording, std::vector<kodi::addon::PVRStreamProperty>& properties)
 {
-  if (!m_session->IsConnected()) {
+  if (!m_session->WaitForConnection()) {
     return PVR_ERROR_SERVER_ERROR;
   }
 
@@ -627,41 +1247,43 @@ PVR_ERROR TeleBoy::GetTimers(kodi::addon::PVRTimersResultSet& results)
     for (Value::ConstValueIterator itr1 = items.Begin(); itr1 != items.End();
         ++itr1)
     {
-      const Value& item = (*itr1);
       sum++;
+      TransferTimer(*itr1, results);
+    }
+  }
 
-      kodi::addon::PVRTimer tag;
-
-      tag.SetClientIndex(item["id"].GetInt());
-      tag.SetTitle(GetStringOrEmpty(item, "title"));
-      tag.SetSummary(GetStringOrEmpty(item, "subtitle"));
-      tag.SetStartTime(Utils::StringToTime(GetStringOrEmpty(item, "begin")));
-      tag.SetEndTime(Utils::StringToTime(GetStringOrEmpty(item, "end")));
-      tag.SetState(PVR_TIMER_STATE_SCHEDULED);
-      tag.SetTimerType(1);
-      tag.SetEPGUid(item["id"].GetInt());
-      tag.SetClientChannelUid(item["station_id"].GetInt());
-      if (item.HasMember("genre_id")) {
-        int genreId = item["genre_id"].GetInt();
-        TeleboyGenre genre = genresById[genreId];
-        int kodiGenre = m_categories.Category(genre.nameEn);
-        if (kodiGenre != 0) {
-          tag.SetGenreSubType(kodiGenre & 0x0F);
-          tag.SetGenreType(kodiGenre & 0xF0);
-        }
-      }
+  return PVR_ERROR_NO_ERROR;
+}
 
-      results.Add(tag);
-      UpdateThread::SetNextRecordingUpdate(tag.GetEndTime() + 60 * 21);
+void TeleBoy::TransferTimer(const Value& item, kodi::addon::PVRTimersResultSet& results)
+{
+  kodi::addon::PVRTimer tag;
+
+  tag.SetClientIndex(item["id"].GetInt());
+  tag.SetTitle(GetStringOrEmpty(item, "title"));
+  tag.SetSummary(GetStringOrEmpty(item, "subtitle"));
+  tag.SetStartTime(Utils::StringToTime(GetStringOrEmpty(item, "begin")));
+  tag.SetEndTime(Utils::StringToTime(GetStringOrEmpty(item, "end")));
+  tag.SetState(PVR_TIMER_STATE_SCHEDULED);
+  tag.SetTimerType(1);
+  tag.SetEPGUid(item["id"].GetInt());
+  tag.SetClientChannelUid(item["station_id"].GetInt());
+  if (item.HasMember("genre_id")) {
+    TeleboyGenre genre = GetGenre(item["genre_id"].GetInt());
+    int kodiGenre = genre.kodiGenre;
+    if (kodiGenre != 0) {
+      tag.SetGenreSubType(kodiGenre & 0x0F);
+      tag.SetGenreType(kodiGenre & 0xF0);
     }
   }
 
-  return PVR_ERROR_NO_ERROR;
+  results.Add(tag);
+  UpdateThread::SetNextRecordingUpdate(tag.GetEndTime() + 60 * 21);
 }
 
 PVR_ERROR TeleBoy::AddTimer(const kodi::addon::PVRTimer& timer)
 {
-  if (!m_session->IsConnected()) {
+  if (!m_session->WaitForConnection()) {
     return PVR_ERROR_SERVER_ERROR;
   }
 
@@ -686,7 +1308,7 @@ PVR_ERROR TeleBoy::AddTimer(const kodi::addon::PVRTimer& timer)
 
 PVR_ERROR TeleBoy::DeleteTimer(const kodi::addon::PVRTimer& timer, bool forceDelete)
 {
-  if (!m_session->IsConnected()) {
+  if (!m_session->WaitForConnection()) {
     return PVR_ERROR_SERVER_ERROR;
   }
 
@@ -739,7 +1361,7 @@ PVR_ERROR TeleBoy::IsEPGTagRecordable(const kodi::addon::PVREPGTag& tag, bool& i
 
 PVR_ERROR TeleBoy::GetEPGTagStreamProperties(const kodi::addon::PVREPGTag& tag, std::vector<kodi::addon::PVRStreamProperty>& properties)
 {
-  if (!m_session->IsConnected()) {
+  if (!m_session->WaitForConnection()) {
     return PVR_ERROR_SERVER_ERROR;
   }
 
@@ -769,11 +1391,23 @@ PVR_ERROR TeleBoy::GetEPGTagEdl(const kodi::addon::PVREPGTag& tag, std::vector<k
 
 string TeleBoy::GetStringOrEmpty(const Value& jsonValue, const char* fieldName)
 {
-  if (!jsonValue.HasMember(fieldName) || !jsonValue[fieldName].IsString())
+  Value::ConstMemberIterator member = jsonValue.FindMember(fieldName);
+  if (member == jsonValue.MemberEnd() || !member->value.IsString())
   {
     return "";
   }
-  return jsonValue[fieldName].GetString();
+  return string(member->value.GetString(), member->value.GetStringLength());
+}
+
+TeleboyGenre TeleBoy::GetGenre(int genreId)
+{
+  std::lock_guard<std::mutex> lock(genresMutex);
+  auto genre = genresById.find(genreId);
+  if (genre == genresById.end())
+  {
+    return TeleboyGenre();
+  }
+  return genre->second;
 }
 
 std::string TeleBoy::GetStreamParameters() {
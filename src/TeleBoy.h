@@ -2,6 +2,7 @@
 #include "categories.h"
 #include <map>
 #include <mutex>
+#include <set>
 #include "rapidjson/document.h"
 #include "sql/ParameterDB.h"
 #include "http/HttpClient.h"
@@ -19,10 +20,33 @@ struct TeleBoyChannel
   std::string logoPath;
 };
 
+struct PrefetchedStream
+{
+  std::vector<kodi::addon::PVRStreamProperty> properties;
+  time_t validUntil;
+  // the stream is still being fetched
+  bool pending;
+};
+
+struct RedirectTarget
+{
+  std::string target;
+  time_t validUntil;
+};
+
+// what kodi was sent for a broadcast
+struct SentEpgTag
+{
+  uint64_t fingerprint;
+  time_t startTime;
+  time_t sentAt;
+};
+
 struct TeleboyGenre
 {
   std::string name;
   std::string nameEn;
+  int kodiGenre = 0;
 };
 
 class ATTR_DLL_LOCAL TeleBoy : public kodi::addon::CAddonBase,
@@ -48,6 +72,9 @@ public:
   PVR_ERROR GetEPGForChannel(int channelUid, time_t start, time_t end,
         kodi::addon::PVREPGTagsResultSet& results) override;
   void GetEPGForChannelAsync(int uniqueChannelId, time_t iStart, time_t iEnd);
+  void WarmUpEpg(int uniqueChannelId);
+  void LoadNowNext();
+  void PrefetchChannelStream(int uniqueChannelId);
   PVR_ERROR GetRecordingsAmount(bool deleted, int& amount) override;
   PVR_ERROR GetRecordings(bool deleted, kodi::addon::PVRRecordingsResultSet& results) override;
   PVR_ERROR GetRecordingStreamProperties(const kodi::addon::PVRRecording& recording,
@@ -69,10 +96,19 @@ public:
   void UpdateConnectionState(const std::string& connectionString, PVR_CONNECTION_STATE newState, const std::string& message);
   bool SessionInitialized();
 
-private:
+protected:
+  // protected for the benchmarks in tools/benchmark, which feed the
+  // conversion methods with payloads instead of api responses
   map<int, TeleBoyChannel> channelsById;
   map<int, TeleboyGenre> genresById;
+  std::mutex genresMutex;
   static std::mutex sendEpgToKodiMutex;
+  // by channel and broadcast id, guarded by sendEpgToKodiMutex
+  map<int, map<unsigned, SentEpgTag>> sentEpgTags;
+  map<int, PrefetchedStream> prefetchedStreams;
+  std::mutex prefetchedStreamsMutex;
+  map<string, RedirectTarget> redirectTargets;
+  std::mutex redirectTargetsMutex;
   vector<int> sortedChannels;
   vector<UpdateThread*> updateThreads;
   Categories m_categories;
@@ -80,14 +116,29 @@ private:
   HttpClient *m_httpClient;
   Session *m_session;
 
-  virtual string FormatDate(time_t dateTime);
-  virtual bool ApiGetResult(string content, Document &doc);
+  string FormatDateTime(time_t dateTime);
+  void TransferEpgTag(const Value& item, int uniqueChannelId);
+  void TransferRecording(const Value& item, kodi::addon::PVRRecordingsResultSet& results);
+  void TransferTimer(const Value& item, kodi::addon::PVRTimersResultSet& results);
+  uint64_t GetEpgFingerprint(const Value& item);
+  void DeleteMissingEpgTags(int uniqueChannelId, time_t windowStart, time_t windowEnd,
+      const std::set<unsigned>& broadcastIds);
+  string GetBroadcastsUrl(int uniqueChannelId, time_t sliceStart, int skip, int sliceCount = 1);
+  bool LoadEpgSlice(int uniqueChannelId, time_t sliceStart, std::set<unsigned>* broadcastIds);
+  bool LoadMissingEpgSlices(int uniqueChannelId, time_t windowStart, time_t windowEnd);
+  bool LoadEpgSlices(int uniqueChannelId, time_t firstSliceStart, int sliceCount);
+  virtual bool ApiGetResult(const string& content, Document &doc);
+  virtual bool ApiGetResult(string_view content, Document &doc);
   virtual bool ApiGet(string url, Document &doc, time_t cacheDuration);
   virtual bool ApiGetWithoutConnectedCheck(string url, Document &doc, time_t timeout);
   virtual bool ApiPost(string url, string postData, Document &doc);
   virtual bool ApiDelete(string url, Document &doc);
   virtual string FollowRedirect(string url);
+  string GetCachedRedirect(const string& url);
+  void CacheRedirect(const string& url, const string& target);
+  void ForgetRedirects(const string& url);
   virtual string GetStringOrEmpty(const Value& jsonValue, const char* fieldName);
+  TeleboyGenre GetGenre(int genreId);
   void TransferChannel(kodi::addon::PVRChannelsResultSet& results, TeleBoyChannel channel,
       int channelNum);
   bool WriteDataJson();
@@ -95,6 +146,12 @@ private:
   std::string GetStreamParameters();
   void LoadGenres();
   bool LoadChannels();
+  PVR_ERROR GetLiveStreamProperties(int uniqueChannelId,
+        std::vector<kodi::addon::PVRStreamProperty>& properties);
+  bool TakePrefetchedStream(int uniqueChannelId,
+        std::vector<kodi::addon::PVRStreamProperty>& properties);
+  void PrefetchAdjacentChannels(int uniqueChannelId);
+  vector<int> GetChannelOrder();
   PVR_ERROR SetStreamProperties(std::vector<kodi::addon::PVRStreamProperty>& properties,
         const Value& stream, bool realtime);
   void AddTimerType(std::vector<kodi::addon::PVRTimerType>& types, int idx, int attributes);
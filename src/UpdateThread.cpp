@@ -2,14 +2,21 @@
 #include <time.h>
 #include "TeleBoy.h"
 #include "http/Cache.h"
+#include "http/HttpStatistics.h"
 
 #include "kodi/General.h"
 
+#include <algorithm>
 #include <chrono>
 
 const time_t maximumUpdateInterval = 600;
 
-std::queue<EpgQueueEntry> UpdateThread::loadEpgQueue;
+std::deque<EpgQueueEntry> UpdateThread::loadEpgQueue;
+std::multiset<int> UpdateThread::loadingEpg;
+std::queue<int> UpdateThread::prefetchStreamQueue;
+std::deque<int> UpdateThread::warmUpEpgQueue;
+std::atomic<bool> UpdateThread::loadNowNext = {false};
+std::atomic<bool> UpdateThread::nowNextInProgress = {false};
 time_t UpdateThread::nextRecordingsUpdate;
 std::mutex UpdateThread::mutex;
 
@@ -53,12 +60,85 @@ void UpdateThread::LoadEpg(int uniqueChannelId, time_t startTime,
   entry.endTime = endTime;
 
   std::lock_guard<std::mutex> lock(mutex);
-  loadEpgQueue.push(entry);
+  loadEpgQueue.push_back(entry);
+}
+
+void UpdateThread::PrefetchStream(int uniqueChannelId)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  prefetchStreamQueue.push(uniqueChannelId);
+}
+
+void UpdateThread::WarmUpEpg(int uniqueChannelId)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (std::find(warmUpEpgQueue.begin(), warmUpEpgQueue.end(), uniqueChannelId)
+      == warmUpEpgQueue.end())
+  {
+    warmUpEpgQueue.push_back(uniqueChannelId);
+  }
+}
+
+void UpdateThread::LoadNowNext()
+{
+  loadNowNext = true;
+}
+
+void UpdateThread::LoadQueuedEpg()
+{
+  while (!loadEpgQueue.empty())
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!loadEpgQueue.empty())
+    {
+      EpgQueueEntry entry = loadEpgQueue.front();
+      loadEpgQueue.pop_front();
+      auto loading = loadingEpg.insert(entry.uniqueChannelId);
+      lock.unlock();
+      m_teleboy.GetEPGForChannelAsync(entry.uniqueChannelId,
+          entry.startTime, entry.endTime);
+      lock.lock();
+      loadingEpg.erase(loading);
+    }
+  }
+
+  // one channel at a time, so requests of kodi are not held up
+  if (!warmUpEpgQueue.empty())
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!warmUpEpgQueue.empty())
+    {
+      int uniqueChannelId = warmUpEpgQueue.front();
+      warmUpEpgQueue.pop_front();
+      // the load requested by kodi fetches the same slices
+      bool pending = IsEpgLoadPending(uniqueChannelId);
+      lock.unlock();
+      if (!pending)
+      {
+        m_teleboy.WarmUpEpg(uniqueChannelId);
+      }
+    }
+  }
+}
+
+// Whether an epg load of the channel is queued or running, call with mutex held
+bool UpdateThread::IsEpgLoadPending(int uniqueChannelId)
+{
+  if (loadingEpg.find(uniqueChannelId) != loadingEpg.end())
+  {
+    return true;
+  }
+  return std::any_of(loadEpgQueue.begin(), loadEpgQueue.end(),
+      [uniqueChannelId](const EpgQueueEntry& entry)
+      {
+        return entry.uniqueChannelId == uniqueChannelId;
+      });
 }
 
 void UpdateThread::Process()
 {
   kodi::Log(ADDON_LOG_DEBUG, "Update thread started.");
+  HttpClient::SetThreadPriority(PRIORITY_BACKGROUND);
   while (m_running)
   {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -69,21 +149,39 @@ void UpdateThread::Process()
 
     if (m_threadIdx == 0) {
       Cache::Cleanup();
+      HttpStatistics::Dump();
     }
 
-    while (!loadEpgQueue.empty())
+    while (!prefetchStreamQueue.empty())
     {
       std::unique_lock<std::mutex> lock(mutex);
-      if (!loadEpgQueue.empty())
+      if (!prefetchStreamQueue.empty())
       {
-        EpgQueueEntry entry = loadEpgQueue.front();
-        loadEpgQueue.pop();
+        int uniqueChannelId = prefetchStreamQueue.front();
+        prefetchStreamQueue.pop();
         lock.unlock();
-        m_teleboy.GetEPGForChannelAsync(entry.uniqueChannelId,
-            entry.startTime, entry.endTime);
+        m_teleboy.PrefetchChannelStream(uniqueChannelId);
       }
     }
 
+    // the current broadcasts go to kodi before any full epg
+    if (loadNowNext && !nowNextInProgress.exchange(true))
+    {
+      // cleared before loading, so that a request during the load is kept
+      loadNowNext = false;
+      // users are waiting for it, as for a ui request
+      HttpClient::SetThreadPriority(PRIORITY_UI);
+      m_teleboy.LoadNowNext();
+      HttpClient::SetThreadPriority(PRIORITY_BACKGROUND);
+      nowNextInProgress = false;
+    }
+    // the epg waits for the current broadcasts, the updates of recordings
+    // and timers do not
+    if (!loadNowNext && !nowNextInProgress)
+    {
+      LoadQueuedEpg();
+    }
+
     time_t currentTime;
     time(&currentTime);
 
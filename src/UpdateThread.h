@@ -1,8 +1,10 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
 #include <mutex>
 #include <queue>
+#include <set>
 #include <thread>
 #include "Session.h"
 
@@ -22,13 +24,24 @@ public:
   ~UpdateThread();
   static void SetNextRecordingUpdate(time_t nextRecordingsUpdate);
   static void LoadEpg(int uniqueChannelId, time_t startTime, time_t endTime);
+  static void PrefetchStream(int uniqueChannelId);
+  static void WarmUpEpg(int uniqueChannelId);
+  static void LoadNowNext();
   void Process();
 
 private:
+  void LoadQueuedEpg();
+  static bool IsEpgLoadPending(int uniqueChannelId);
   TeleBoy& m_teleboy;
   Session& m_session;
   int m_threadIdx;
-  static std::queue<EpgQueueEntry> loadEpgQueue;
+  static std::deque<EpgQueueEntry> loadEpgQueue;
+  // channels of the entries taken from loadEpgQueue and not yet loaded
+  static std::multiset<int> loadingEpg;
+  static std::queue<int> prefetchStreamQueue;
+  static std::deque<int> warmUpEpgQueue;
+  static std::atomic<bool> loadNowNext;
+  static std::atomic<bool> nowNextInProgress;
   static time_t nextRecordingsUpdate;
   std::atomic<bool> m_running = {false};
   std::thread m_thread;
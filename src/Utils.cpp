@@ -4,6 +4,7 @@
 #endif
 
 #include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <iterator>
 #include <sstream>
@@ -91,38 +92,114 @@ std::string Utils::ReadFile(const std::string path)
     return "";
   }
 
-  char buf[1025];
-  size_t nbRead;
   std::string content;
-  while ((nbRead = file.Read(buf, 1024)) > 0)
+  int64_t length = file.GetLength();
+  if (length > 0)
   {
-    buf[nbRead] = 0;
-    content.append(buf);
+    content.reserve(static_cast<size_t>(length));
+  }
+  char buf[64 * 1024];
+  ssize_t nbRead;
+  while ((nbRead = file.Read(buf, sizeof(buf))) > 0)
+  {
+    content.append(buf, nbRead);
   }
   return content;
 
 }
 
-time_t Utils::StringToTime(std::string timeString)
+bool Utils::WriteFile(const std::string& path, const char* data, size_t length)
+{
+  kodi::vfs::CFile file;
+  if (!file.OpenFileForWrite(path, true))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Could not write to file [%s].", path.c_str());
+    return false;
+  }
+  return file.Write(data, length) == static_cast<ssize_t>(length);
+}
+
+// http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+static int64_t DaysFromCivil(int64_t y, unsigned m, unsigned d)
+{
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+static bool ParseDigits(std::string_view str, size_t& pos, size_t count, int& value)
+{
+  if (pos + count > str.size())
+  {
+    return false;
+  }
+  value = 0;
+  for (size_t end = pos + count; pos < end; ++pos)
+  {
+    unsigned digit = static_cast<unsigned>(str[pos] - '0');
+    if (digit > 9)
+    {
+      return false;
+    }
+    value = value * 10 + static_cast<int>(digit);
+  }
+  return true;
+}
+
+static bool ParseSeparator(std::string_view str, size_t& pos, const char* separators)
+{
+  if (pos >= str.size() || !strchr(separators, str[pos]))
+  {
+    return false;
+  }
+  ++pos;
+  return true;
+}
+
+// Parses "YYYY-MM-DDTHH:MM:SS" followed by an optional "Z", "+HH", "+HHMM"
+// or "+HH:MM" offset.
+time_t Utils::StringToTime(std::string_view timeString)
 {
-  struct tm tm;
+  int year, month, day, h, m, s;
+  size_t pos = 0;
+  if (!ParseDigits(timeString, pos, 4, year) || !ParseSeparator(timeString, pos, "-")
+      || !ParseDigits(timeString, pos, 2, month) || !ParseSeparator(timeString, pos, "-")
+      || !ParseDigits(timeString, pos, 2, day) || !ParseSeparator(timeString, pos, "T ")
+      || !ParseDigits(timeString, pos, 2, h) || !ParseSeparator(timeString, pos, ":")
+      || !ParseDigits(timeString, pos, 2, m) || !ParseSeparator(timeString, pos, ":")
+      || !ParseDigits(timeString, pos, 2, s))
+  {
+    return 0;
+  }
+
+  // skip fractional seconds
+  if (pos < timeString.size() && timeString[pos] == '.')
+  {
+    do
+    {
+      ++pos;
+    } while (pos < timeString.size() && timeString[pos] >= '0' && timeString[pos] <= '9');
+  }
 
-  int year, month, day, h, m, s, tzh, tzm;
-  if (sscanf(timeString.c_str(), "%d-%d-%dT%d:%d:%d%d", &year, &month, &day, &h,
-      &m, &s, &tzh) < 7)
+  int offset = 0;
+  if (pos < timeString.size() && (timeString[pos] == '+' || timeString[pos] == '-'))
   {
-    tzh = 0;
+    int sign = timeString[pos++] == '-' ? -1 : 1;
+    int tzh = 0, tzm = 0;
+    if (ParseDigits(timeString, pos, 2, tzh))
+    {
+      ParseSeparator(timeString, pos, ":");
+      if (!ParseDigits(timeString, pos, 2, tzm))
+      {
+        tzm = 0;
+      }
+    }
+    offset = sign * (tzh * 3600 + tzm * 60);
   }
-  tzm = tzh % 100;
-  tzh = tzh / 100;
-
-  tm.tm_year = year - 1900;
-  tm.tm_mon = month - 1;
-  tm.tm_mday = day;
-  tm.tm_hour = h - tzh;
-  tm.tm_min = m - tzm;
-  tm.tm_sec = s;
-
-  time_t ret = timegm(&tm);
-  return ret;
+
+  int64_t days = DaysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day));
+  return static_cast<time_t>(days * 86400 + h * 3600 + m * 60 + s - offset);
 }
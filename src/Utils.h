@@ -2,6 +2,7 @@
 
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class Utils
@@ -12,7 +13,8 @@ public:
   static double StringToDouble(const std::string &value);
   static int StringToInt(const std::string &value);
   static std::string ReadFile(const std::string path);
+  static bool WriteFile(const std::string& path, const char* data, size_t length);
   static std::vector<std::string> SplitString(const std::string &str,
       const char &delim, int maxParts = 0);
-  static time_t StringToTime(std::string timeString);
+  static time_t StringToTime(std::string_view timeString);
 };
@@ -1,6 +1,14 @@
 #include "Cache.h"
+#include <algorithm>
+#include <set>
+#include <vector>
 #include <kodi/Filesystem.h>
+#include "HttpStatistics.h"
 #include "../Utils.h"
+#include "../md5.h"
+#include "../xxhash.h"
+#include "../lz4.h"
+#include "../MappedFile.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
@@ -18,74 +26,443 @@ using namespace rapidjson;
 
 constexpr char CACHE_DIR[] = "special://profile/addon_data/pvr.teleboy/cache/";
 
+// time to collect further writes before they go to disk
+static const int WRITE_BATCH_DELAY_MS = 500;
+constexpr char TEMP_SUFFIX[] = ".tmp";
+// length of the md5 keys used before the switch to xxhash
+static const size_t LEGACY_KEY_LENGTH = 32;
+// entries are spread over subdirectories named by the first hex digits of the key
+static const size_t SHARD_PREFIX_LENGTH = 2;
+// eviction frees space down to this share of the capacity
+static const double EVICTION_WATERMARK = 0.9;
+
 time_t Cache::m_lastCleanup = 0;
+std::map<std::string, CacheWrite> Cache::m_pendingWrites;
+std::mutex Cache::m_writesMutex;
+std::condition_variable Cache::m_writesCondition;
+std::thread Cache::m_writerThread;
+bool Cache::m_running = false;
+std::mutex Cache::m_filesMutex;
+std::map<std::string, CacheIndexEntry> Cache::m_index;
+uint64_t Cache::m_indexSize = 0;
+uint64_t Cache::m_capacity = 100 * 1024 * 1024;
+std::mutex Cache::m_indexMutex;
+std::set<std::string> Cache::m_shards;
+std::atomic<bool> Cache::m_migrated = {false};
+std::atomic<bool> Cache::m_legacyKeys = {true};
 
-bool Cache::Read(const std::string& key, std::string& data)
+std::string Cache::GetKey(const std::string& url)
 {
-  std::string cacheFile = CACHE_DIR + key;
-  if (!kodi::vfs::FileExists(cacheFile, true))
+#ifdef CACHE_KEY_MD5
+  return md5(url);
+#else
+  return xxhash64(url);
+#endif
+}
+
+bool Cache::Read(const std::string& url, CacheEntry& entry, int& statusCode)
+{
+  std::string key = GetKey(url);
+  if (ReadPending(key, url, entry, statusCode))
   {
+    HttpStatistics::RecordCacheHit();
+    return true;
+  }
+  EntryState state = ReadEntry(key, url, entry, statusCode);
+#ifndef CACHE_KEY_MD5
+  // entries written before the switch to xxhash are named by md5
+  if (state == ENTRY_MISSING && m_legacyKeys)
+  {
+    state = ReadEntry(md5(url), url, entry, statusCode);
+  }
+#endif
+  switch (state)
+  {
+  case ENTRY_VALID:
+    HttpStatistics::RecordCacheHit();
+    return true;
+  case ENTRY_EXPIRED:
+    HttpStatistics::RecordCacheStale();
+    return false;
+  default:
+    HttpStatistics::RecordCacheMiss();
     return false;
   }
-  std::string jsonString = Utils::ReadFile(cacheFile);
-  if (jsonString.empty())
+}
+
+std::string Cache::GetPath(const std::string& key)
+{
+  return CACHE_DIR + key.substr(0, SHARD_PREFIX_LENGTH) + "/" + key;
+}
+
+bool Cache::EnsureShard(const std::string& key)
+{
+  std::string shard = key.substr(0, SHARD_PREFIX_LENGTH);
+  if (m_shards.find(shard) != m_shards.end())
   {
+    return true;
+  }
+  std::string shardDir = CACHE_DIR + shard + "/";
+  if (!kodi::vfs::DirectoryExists(shardDir) && !kodi::vfs::CreateDirectory(shardDir))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Could not create cache directory [%s].", shardDir.c_str());
     return false;
   }
-  Document doc;
-  doc.Parse(jsonString.c_str());
-  if (doc.GetParseError())
+  m_shards.insert(shard);
+  return true;
+}
+
+Cache::EntryState Cache::ReadEntry(const std::string& key, const std::string& url,
+    CacheEntry& entry, int& statusCode)
+{
+  std::string cacheFile = GetPath(key);
+  if (!kodi::vfs::FileExists(cacheFile, true))
   {
-    if (kodi::vfs::FileExists(cacheFile, true))
+    // not yet moved by the cleanup
+    cacheFile = CACHE_DIR + key;
+    if (m_migrated || !kodi::vfs::FileExists(cacheFile, true))
     {
-      kodi::Log(ADDON_LOG_ERROR, "Parsing cache file [%s] failed.", cacheFile.c_str());
+      return ENTRY_MISSING;
     }
-    return false;
+  }
+  MappedFile& file = entry.m_file;
+  if (!file.Open(cacheFile))
+  {
+    return ENTRY_MISSING;
+  }
+  std::string_view content = file.View();
+  Document header;
+  size_t payloadOffset;
+  if (!ParseHeader(content, header, payloadOffset))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Parsing cache file [%s] failed.", cacheFile.c_str());
+    return ENTRY_INVALID;
   }
 
-  if (!IsStillValid(doc))
+  if (header.HasMember("url") && url != header["url"].GetString())
+  {
+    kodi::Log(ADDON_LOG_DEBUG, "Ignoring cache file [%s] due to key collision.",
+        cacheFile.c_str());
+    return ENTRY_INVALID;
+  }
+
+  if (!IsStillValid(header))
   {
     kodi::Log(ADDON_LOG_DEBUG, "Ignoring cache file [%s] due to expiry.",
         cacheFile.c_str());
-    return false;
+    return ENTRY_EXPIRED;
   }
 
+  if (payloadOffset == std::string::npos)
+  {
+    entry.Assign(std::string(header["data"].GetString(), header["data"].GetStringLength()));
+    file.Close();
+  }
+  else if (!DecodePayload(header, content.substr(payloadOffset), entry))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Decoding cache file [%s] failed.", cacheFile.c_str());
+    return ENTRY_INVALID;
+  }
   kodi::Log(ADDON_LOG_DEBUG, "Load from cache file [%s].", cacheFile.c_str());
-  data = doc["data"].GetString();
-  return !data.empty();
+  Touch(key, content.size());
+  // failed responses are cached with their status code and possibly no data
+  if (header.HasMember("status"))
+  {
+    statusCode = header["status"].GetInt();
+    return ENTRY_VALID;
+  }
+  statusCode = 200;
+  return entry.View().empty() ? ENTRY_INVALID : ENTRY_VALID;
 }
 
-void Cache::Write(const std::string& key, const std::string& data, time_t validUntil)
+// An entry consists of a json header line followed by the payload. Entries
+// of older versions are a single json document including the data.
+bool Cache::ParseHeader(std::string_view content, Document& header, size_t& payloadOffset)
 {
-  if (!kodi::vfs::DirectoryExists(CACHE_DIR))
+  size_t headerEnd = content.find('\n');
+  if (headerEnd == std::string::npos)
+  {
+    header.Parse(content.data(), content.size());
+    payloadOffset = std::string::npos;
+    return IsValidHeader(header) && header.HasMember("data") && header["data"].IsString();
+  }
+  header.Parse(content.data(), headerEnd);
+  payloadOffset = headerEnd + 1;
+  return IsValidHeader(header) && header.HasMember("codec") && header["codec"].IsString()
+      && header.HasMember("size") && header["size"].IsUint64();
+}
+
+// checks the types of the fields shared by both formats, a damaged file must
+// not reach the typed getters
+bool Cache::IsValidHeader(const Document& header)
+{
+  if (header.HasParseError() || !header.IsObject() || !header.HasMember("validUntil")
+      || !header["validUntil"].IsUint64())
+  {
+    return false;
+  }
+  if (header.HasMember("url") && !header["url"].IsString())
+  {
+    return false;
+  }
+  return !header.HasMember("status") || header["status"].IsInt();
+}
+
+bool Cache::DecodePayload(const Value& header, std::string_view payload, CacheEntry& entry)
+{
+  std::string codec = header["codec"].GetString();
+  if (codec == "none")
+  {
+    // points into the mapping of the entry
+    entry.Assign(payload);
+    return true;
+  }
+  if (codec == "lz4")
+  {
+    std::string data;
+    if (!LZ4Decompress(payload.data(), payload.size(), header["size"].GetUint64(), data))
+    {
+      return false;
+    }
+    entry.Assign(std::move(data));
+    entry.m_file.Close();
+    return true;
+  }
+  kodi::Log(ADDON_LOG_ERROR, "Unknown cache codec [%s].", codec.c_str());
+  return false;
+}
+
+bool Cache::ReadPending(const std::string& key, const std::string& url,
+    CacheEntry& entry, int& statusCode)
+{
+  std::lock_guard<std::mutex> lock(m_writesMutex);
+  auto it = m_pendingWrites.find(key);
+  if (it == m_pendingWrites.end() || it->second.url != url
+      || it->second.validUntil < time(nullptr))
+  {
+    return false;
+  }
+  entry.Assign(std::string(it->second.data));
+  statusCode = it->second.statusCode;
+  return true;
+}
+
+void Cache::Write(const std::string& url, const std::string& data, time_t validUntil,
+    int statusCode)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_writesMutex);
+    m_pendingWrites[GetKey(url)] = { url, data, validUntil, statusCode };
+    if (!m_running)
+    {
+      m_running = true;
+      m_writerThread = std::thread([] { WriterThread(); });
+    }
+  }
+  m_writesCondition.notify_all();
+}
+
+void Cache::Shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_writesMutex);
+    m_running = false;
+  }
+  m_writesCondition.notify_all();
+  if (m_writerThread.joinable())
+  {
+    m_writerThread.join();
+  }
+  FlushWrites();
+}
+
+void Cache::WriterThread()
+{
+  std::unique_lock<std::mutex> lock(m_writesMutex);
+  while (m_running)
+  {
+    m_writesCondition.wait(lock, [] { return !m_running || !m_pendingWrites.empty(); });
+    if (!m_running)
+    {
+      break;
+    }
+    // collect writes which follow shortly after into the same batch
+    m_writesCondition.wait_for(lock, std::chrono::milliseconds(WRITE_BATCH_DELAY_MS),
+        [] { return !m_running; });
+    lock.unlock();
+    FlushWrites();
+    lock.lock();
+  }
+}
+
+void Cache::FlushWrites()
+{
+  std::map<std::string, CacheWrite> writes;
   {
-    if (!kodi::vfs::CreateDirectory(CACHE_DIR))
+    std::lock_guard<std::mutex> lock(m_writesMutex);
+    if (m_pendingWrites.empty())
     {
-      kodi::Log(ADDON_LOG_ERROR, "Could not crate cache directory [%s].", CACHE_DIR);
       return;
     }
+    writes = m_pendingWrites;
   }
-  std::string cacheFile = CACHE_DIR + key;
-  kodi::vfs::CFile file;
-  if (!file.OpenFileForWrite(cacheFile, true))
   {
-    kodi::Log(ADDON_LOG_ERROR, "Could not write to cache file [%s].",
-        cacheFile.c_str());
-    return;
+    std::lock_guard<std::mutex> lock(m_filesMutex);
+    if (!kodi::vfs::DirectoryExists(CACHE_DIR) && !kodi::vfs::CreateDirectory(CACHE_DIR))
+    {
+      kodi::Log(ADDON_LOG_ERROR, "Could not create cache directory [%s].", CACHE_DIR);
+    }
+    else
+    {
+      for (auto const &write : writes)
+      {
+        WriteEntry(write.first, write.second);
+      }
+      Evict();
+    }
   }
+  // entries stay readable from memory until they are on disk
+  std::lock_guard<std::mutex> lock(m_writesMutex);
+  for (auto const &write : writes)
+  {
+    auto it = m_pendingWrites.find(write.first);
+    if (it != m_pendingWrites.end() && it->second.validUntil == write.second.validUntil
+        && it->second.statusCode == write.second.statusCode
+        && it->second.data == write.second.data)
+    {
+      m_pendingWrites.erase(it);
+    }
+  }
+}
 
-  Document d;
-  d.SetObject();
-  d.AddMember("validUntil", static_cast<uint64_t>(validUntil), d.GetAllocator());
-  Value value;
-  value.SetString(data.c_str(), static_cast<SizeType>(data.length()), d.GetAllocator());
-  d.AddMember("data", value, d.GetAllocator());
+// Entries are written to a temporary file first and renamed afterwards, so
+// readers never see a partially written entry.
+void Cache::WriteEntry(const std::string& key, const CacheWrite& entry)
+{
+  const std::string& data = entry.data;
+  const char* codec = "none";
+  std::string payload;
+#ifdef CACHE_COMPRESSION
+  payload = LZ4Compress(data.c_str(), data.length());
+  if (payload.length() < data.length())
+  {
+    codec = "lz4";
+  }
+  else
+  {
+    payload.clear();
+  }
+#endif
 
   StringBuffer buffer;
   Writer<StringBuffer> writer(buffer);
-  d.Accept(writer);
-  const char* output = buffer.GetString();
-  file.Write(output, strlen(output));
+  writer.StartObject();
+  writer.Key("validUntil");
+  writer.Uint64(static_cast<uint64_t>(entry.validUntil));
+  writer.Key("url");
+  writer.String(entry.url.c_str(), static_cast<SizeType>(entry.url.length()));
+  writer.Key("codec");
+  writer.String(codec);
+  writer.Key("size");
+  writer.Uint64(data.length());
+  writer.Key("status");
+  writer.Int(entry.statusCode);
+  writer.EndObject();
+
+  std::string content(buffer.GetString(), buffer.GetSize());
+  content += '\n';
+  content += payload.empty() ? data : payload;
+
+  if (!EnsureShard(key))
+  {
+    return;
+  }
+  std::string cacheFile = GetPath(key);
+  std::string tempFile = cacheFile + TEMP_SUFFIX;
+  if (!Utils::WriteFile(tempFile, content.c_str(), content.length()))
+  {
+    kodi::vfs::DeleteFile(tempFile);
+    return;
+  }
+  if (!kodi::vfs::RenameFile(tempFile, cacheFile))
+  {
+    // not every platform replaces an existing file on rename
+    kodi::vfs::DeleteFile(cacheFile);
+    if (!kodi::vfs::RenameFile(tempFile, cacheFile))
+    {
+      kodi::Log(ADDON_LOG_ERROR, "Could not rename cache file [%s].", tempFile.c_str());
+      kodi::vfs::DeleteFile(tempFile);
+      return;
+    }
+  }
+  Touch(key, content.length());
+}
+
+void Cache::SetCapacity(uint64_t capacity)
+{
+  std::lock_guard<std::mutex> lock(m_indexMutex);
+  m_capacity = capacity;
+}
+
+void Cache::Touch(const std::string& key, uint64_t size)
+{
+  std::lock_guard<std::mutex> lock(m_indexMutex);
+  CacheIndexEntry& entry = m_index[key];
+  m_indexSize = m_indexSize - entry.size + size;
+  entry.size = size;
+  entry.lastAccess = time(nullptr);
+}
+
+// Removes entries until the cache fits into its capacity again. Entries
+// which are large and were not used for long go first.
+void Cache::Evict()
+{
+  std::vector<std::string> evicted;
+  uint64_t indexSize;
+  uint64_t entries;
+  uint64_t capacity;
+  {
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    if (m_indexSize > m_capacity)
+    {
+      time_t now = time(nullptr);
+      std::vector<std::pair<double, std::string>> candidates;
+      candidates.reserve(m_index.size());
+      for (auto const &entry : m_index)
+      {
+        double age = static_cast<double>(std::max<time_t>(now - entry.second.lastAccess, 0)) + 1;
+        candidates.emplace_back(age * entry.second.size, entry.first);
+      }
+      std::sort(candidates.begin(), candidates.end(),
+          [](const std::pair<double, std::string>& a, const std::pair<double, std::string>& b)
+          { return a.first > b.first; });
+      uint64_t target = static_cast<uint64_t>(m_capacity * EVICTION_WATERMARK);
+      for (auto const &candidate : candidates)
+      {
+        if (m_indexSize <= target)
+        {
+          break;
+        }
+        auto it = m_index.find(candidate.second);
+        m_indexSize -= it->second.size;
+        m_index.erase(it);
+        evicted.push_back(candidate.second);
+      }
+    }
+    indexSize = m_indexSize;
+    entries = m_index.size();
+    capacity = m_capacity;
+  }
+  for (auto const &key : evicted)
+  {
+    kodi::vfs::DeleteFile(GetPath(key));
+  }
+  if (!evicted.empty())
+  {
+    kodi::Log(ADDON_LOG_DEBUG, "Evicted %i cache entries.", static_cast<int>(evicted.size()));
+    HttpStatistics::RecordCacheEvictions(evicted.size());
+  }
+  HttpStatistics::RecordCacheOccupancy(indexSize, entries, capacity);
 }
 
 void Cache::Cleanup()
@@ -99,6 +476,7 @@ void Cache::Cleanup()
   m_lastCleanup = currTime;
   if (!kodi::vfs::DirectoryExists(CACHE_DIR))
   {
+    m_migrated = true;
     return;
   }
   std::vector<kodi::vfs::CDirEntry> items;
@@ -107,35 +485,131 @@ void Cache::Cleanup()
     kodi::Log(ADDON_LOG_ERROR, "Could not get cache directory.");
     return;
   }
+  std::lock_guard<std::mutex> lock(m_filesMutex);
+  std::vector<kodi::vfs::CDirEntry> files;
   for (const auto& item : items)
   {
     if (item.IsFolder())
     {
+      std::vector<kodi::vfs::CDirEntry> shardItems;
+      if (!kodi::vfs::GetDirectory(item.Path(), "", shardItems))
+      {
+        kodi::Log(ADDON_LOG_ERROR, "Could not get cache directory [%s].", item.Path().c_str());
+        continue;
+      }
+      for (const auto& shardItem : shardItems)
+      {
+        if (!shardItem.IsFolder())
+        {
+          files.push_back(shardItem);
+        }
+      }
+      continue;
+    }
+    std::string path = MigrateFile(item.Path());
+    if (!path.empty())
+    {
+      files.emplace_back(item.Label(), path, false, item.Size(), item.DateTime());
+    }
+  }
+  m_migrated = true;
+
+  std::map<std::string, CacheIndexEntry> remaining;
+  for (const auto& entry : files)
+  {
+    const std::string& path = entry.Path();
+    size_t suffixLength = sizeof(TEMP_SUFFIX) - 1;
+    if (path.length() > suffixLength
+        && path.compare(path.length() - suffixLength, suffixLength, TEMP_SUFFIX) == 0)
+    {
+      // left over from an interrupted write
+      kodi::vfs::DeleteFile(path);
       continue;
     }
-    std::string path = item.Path();
-    std::string jsonString = Utils::ReadFile(path);
-    if (jsonString.empty())
+    MappedFile file;
+    if (!file.Open(path))
     {
       continue;
     }
-    Document doc;
-    doc.Parse(jsonString.c_str());
-    if (doc.GetParseError())
+    Document header;
+    size_t payloadOffset;
+    bool valid = ParseHeader(file.View(), header, payloadOffset);
+    file.Close();
+    if (!valid)
     {
       kodi::Log(ADDON_LOG_ERROR, "Parsing cache file [%s] failed. -> Delete", path.c_str());
       kodi::vfs::DeleteFile(path);
+      continue;
     }
 
-    if (!IsStillValid(doc))
+    if (!IsStillValid(header))
     {
       kodi::Log(ADDON_LOG_DEBUG, "Deleting expired cache file [%s].", path.c_str());
       if (!kodi::vfs::DeleteFile(path))
       {
         kodi::Log(ADDON_LOG_DEBUG, "Deletion of file [%s] failed.", path.c_str());
       }
+      continue;
+    }
+    remaining[path.substr(path.rfind('/') + 1)] = {
+        static_cast<uint64_t>(entry.Size()), entry.DateTime() };
+  }
+
+  // stop looking for md5 names once the last of them expired
+  bool legacyKeys = false;
+  for (auto const &entry : remaining)
+  {
+    if (entry.first.length() == LEGACY_KEY_LENGTH)
+    {
+      legacyKeys = true;
+      break;
+    }
+  }
+  m_legacyKeys = legacyKeys;
+
+  // rebuild the index from disk, entries not used since startup are aged by
+  // their last write
+  {
+    std::lock_guard<std::mutex> indexLock(m_indexMutex);
+    std::map<std::string, CacheIndexEntry> index;
+    uint64_t indexSize = 0;
+    for (auto const &entry : remaining)
+    {
+      auto it = m_index.find(entry.first);
+      time_t lastAccess = it == m_index.end() ? entry.second.lastAccess : it->second.lastAccess;
+      index[entry.first] = { entry.second.size, lastAccess };
+      indexSize += entry.second.size;
     }
+    m_index.swap(index);
+    m_indexSize = indexSize;
+  }
+  Evict();
+}
+
+// Moves a file of the former flat layout into its shard. Returns the new
+// path or an empty string if the file is gone.
+std::string Cache::MigrateFile(const std::string& path)
+{
+  std::string key = path.substr(path.rfind('/') + 1);
+  if (key.length() < SHARD_PREFIX_LENGTH || !EnsureShard(key))
+  {
+    kodi::vfs::DeleteFile(path);
+    return "";
+  }
+  std::string target = GetPath(key);
+  if (kodi::vfs::FileExists(target, true))
+  {
+    // the sharded entry is newer
+    kodi::vfs::DeleteFile(path);
+    return "";
+  }
+  if (!kodi::vfs::RenameFile(path, target))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Could not move cache file [%s].", path.c_str());
+    kodi::vfs::DeleteFile(path);
+    return "";
   }
+  return target;
 }
 
 bool Cache::IsStillValid(const Value& cache)
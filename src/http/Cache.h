@@ -1,16 +1,100 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string>
+#include <string_view>
+#include <thread>
 #include "rapidjson/document.h"
+#include "../MappedFile.h"
+
+struct CacheWrite
+{
+  std::string url;
+  std::string data;
+  time_t validUntil;
+  int statusCode;
+};
+
+struct CacheIndexEntry
+{
+  uint64_t size;
+  time_t lastAccess;
+};
+
+// Content of a cache entry. Uncompressed entries stay mapped as long as the
+// entry lives, so that they can be parsed without copying them.
+class CacheEntry
+{
+public:
+  std::string_view View() const { return m_view; }
+private:
+  friend class Cache;
+  void Assign(std::string_view view) { m_view = view; }
+  void Assign(std::string&& data) { m_data = std::move(data); m_view = m_data; }
+  MappedFile m_file;
+  std::string m_data;
+  std::string_view m_view;
+};
 
 class Cache
 {
 public:
-  static bool Read(const std::string& key, std::string& data);
-  static void Write(const std::string& key, const std::string& data,
-      time_t validUntil);
+  static bool Read(const std::string& url, CacheEntry& entry, int& statusCode);
+  static void Write(const std::string& url, const std::string& data,
+      time_t validUntil, int statusCode);
   static void Cleanup();
+  static void Shutdown();
+  static void SetCapacity(uint64_t capacity);
 private:
+  enum EntryState
+  {
+    ENTRY_MISSING,
+    ENTRY_INVALID,
+    ENTRY_EXPIRED,
+    ENTRY_VALID
+  };
+  static std::string GetKey(const std::string& url);
+  static std::string GetPath(const std::string& key);
+  static bool EnsureShard(const std::string& key);
+  static std::string MigrateFile(const std::string& path);
+  static EntryState ReadEntry(const std::string& key, const std::string& url,
+      CacheEntry& entry, int& statusCode);
+  static bool ParseHeader(std::string_view content, rapidjson::Document& header,
+      size_t& payloadOffset);
+  static bool IsValidHeader(const rapidjson::Document& header);
+  static bool DecodePayload(const rapidjson::Value& header, std::string_view payload,
+      CacheEntry& entry);
   static bool IsStillValid(const rapidjson::Value& cache);
+  static bool ReadPending(const std::string& key, const std::string& url,
+      CacheEntry& entry, int& statusCode);
+  static void WriterThread();
+  static void FlushWrites();
+  static void WriteEntry(const std::string& key, const CacheWrite& entry);
+  static void Touch(const std::string& key, uint64_t size);
+  static void Evict();
   static time_t m_lastCleanup;
+  // writes not yet on disk, by key
+  static std::map<std::string, CacheWrite> m_pendingWrites;
+  static std::mutex m_writesMutex;
+  static std::condition_variable m_writesCondition;
+  static std::thread m_writerThread;
+  static bool m_running;
+  // serializes file writes with the cleanup
+  static std::mutex m_filesMutex;
+  // size and last access of the entries on disk, by key
+  static std::map<std::string, CacheIndexEntry> m_index;
+  static uint64_t m_indexSize;
+  static uint64_t m_capacity;
+  static std::mutex m_indexMutex;
+  // shard directories known to exist, guarded by m_filesMutex
+  static std::set<std::string> m_shards;
+  // whether entries of the flat layout were moved into their shards
+  static std::atomic<bool> m_migrated;
+  // whether the last cleanup found entries named by md5
+  static std::atomic<bool> m_legacyKeys;
 };
@@ -0,0 +1,71 @@
+#include "CircuitBreaker.h"
+#include <kodi/AddonBase.h>
+
+CircuitBreaker::CircuitBreaker(int failureThreshold, time_t coolDown):
+  m_failureThreshold(failureThreshold),
+  m_coolDown(coolDown)
+{
+}
+
+std::string CircuitBreaker::GetHost(const std::string& url)
+{
+  std::string::size_type begin = url.find("://");
+  begin = begin == std::string::npos ? 0 : begin + 3;
+  return url.substr(0, url.find('/', begin));
+}
+
+bool CircuitBreaker::AllowRequest(const std::string& url)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_circuits.find(GetHost(url));
+  if (it == m_circuits.end())
+  {
+    return true;
+  }
+  Circuit& circuit = it->second;
+  switch (circuit.state)
+  {
+  case CIRCUIT_CLOSED:
+    return true;
+  case CIRCUIT_OPEN:
+    if (circuit.openUntil > time(nullptr))
+    {
+      return false;
+    }
+    kodi::Log(ADDON_LOG_INFO, "Probing %s after cool-down.", it->first.c_str());
+    circuit.state = CIRCUIT_HALF_OPEN;
+    return true;
+  default:
+    // the probe request is still running
+    return false;
+  }
+}
+
+bool CircuitBreaker::RecordResult(const std::string& url, bool success, bool& open)
+{
+  std::string host = GetHost(url);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Circuit& circuit = m_circuits[host];
+  bool wasOpen = circuit.state != CIRCUIT_CLOSED;
+  if (success)
+  {
+    circuit.state = CIRCUIT_CLOSED;
+    circuit.failures = 0;
+  }
+  else
+  {
+    circuit.failures++;
+    if (circuit.state == CIRCUIT_HALF_OPEN || circuit.failures >= m_failureThreshold)
+    {
+      if (!wasOpen)
+      {
+        kodi::Log(ADDON_LOG_WARNING, "%s failed %i times in a row. Pausing requests for %i s.",
+            host.c_str(), circuit.failures, static_cast<int>(m_coolDown));
+      }
+      circuit.state = CIRCUIT_OPEN;
+      circuit.openUntil = time(nullptr) + m_coolDown;
+    }
+  }
+  open = circuit.state != CIRCUIT_CLOSED;
+  return open != wasOpen;
+}
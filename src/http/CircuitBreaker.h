@@ -0,0 +1,35 @@
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Stops sending requests to a host after repeated failures. After a
+// cool-down a single probe request decides whether the host is back.
+class CircuitBreaker
+{
+public:
+  CircuitBreaker(int failureThreshold, time_t coolDown);
+  bool AllowRequest(const std::string& url);
+  // returns true if the circuit of the host opened or closed
+  bool RecordResult(const std::string& url, bool success, bool& open);
+private:
+  enum CircuitState
+  {
+    CIRCUIT_CLOSED,
+    CIRCUIT_OPEN,
+    CIRCUIT_HALF_OPEN
+  };
+  struct Circuit
+  {
+    CircuitState state = CIRCUIT_CLOSED;
+    int failures = 0;
+    time_t openUntil = 0;
+  };
+  static std::string GetHost(const std::string& url);
+  int m_failureThreshold;
+  time_t m_coolDown;
+  std::map<std::string, Circuit> m_circuits;
+  std::mutex m_mutex;
+};
@@ -43,13 +43,19 @@ std::string Curl::Get(const std::string& url, int &statusCode)
   return Request("GET", url, "", statusCode);
 }
 
+// Performs a GET but only evaluates the response headers
+void Curl::GetHeaders(const std::string& url, int &statusCode)
+{
+  Request("GET", url, "", statusCode, false);
+}
+
 std::string Curl::Post(const std::string& url, const std::string& postData, int &statusCode)
 {
   return Request("POST", url, postData, statusCode);
 }
 
 std::string Curl::Request(const std::string& action, const std::string& url, const std::string& postData,
-    int &statusCode)
+    int &statusCode, bool readBody)
 {
   kodi::vfs::CFile file;
   if (!file.CURLCreate(url))
@@ -106,6 +112,12 @@ std::string Curl::Request(const std::string& action, const std::string& url, con
   }
 
   m_location = file.GetPropertyValue(ADDON_FILE_PROPERTY_RESPONSE_HEADER, "Location");
+  m_retryAfter = file.GetPropertyValue(ADDON_FILE_PROPERTY_RESPONSE_HEADER, "Retry-After");
+
+  if (!readBody)
+  {
+    return "";
+  }
 
   // read the file
   static const unsigned int CHUNKSIZE = 16384;
@@ -8,6 +8,7 @@ public:
   ~Curl();
   std::string Delete(const std::string& url, int &statusCode);
   std::string Get(const std::string& url, int &statusCode);
+  void GetHeaders(const std::string& url, int &statusCode);
   std::string Post(const std::string& url, const std::string& postData,
       int &statusCode);
   void AddHeader(const std::string& name, const std::string& value);
@@ -17,14 +18,19 @@ public:
   std::string GetLocation() {
     return m_location;
   }
+  std::string GetRetryAfter() {
+    return m_retryAfter;
+  }
 
 private:
   std::string Request(const std::string& action, const std::string& url,
-                              const std::string& postData, int &statusCode);
+                              const std::string& postData, int &statusCode,
+                              bool readBody = true);
   std::string Base64Encode(unsigned char const* in, unsigned int in_len,
       bool urlEncode);
   std::map<std::string, std::string> m_headers;
   std::map<std::string, std::string> m_options;
   std::map<std::string, std::string> m_cookies;
   std::string m_location;
+  std::string m_retryAfter;
 };
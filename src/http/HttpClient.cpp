@@ -1,7 +1,11 @@
 #include "HttpClient.h"
 #include "Cache.h"
+#include "HttpStatistics.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <thread>
 #include <random>
-#include "../md5.h"
 #include <kodi/AddonBase.h>
 
 static const std::string USER_AGENT = std::string("Kodi/")
@@ -10,13 +14,39 @@ static const std::string USER_AGENT = std::string("Kodi/")
 
 static const std::string apiDeviceType = "desktop";
 static const std::string apiVersion = "2.0";
+static const std::string apiUrl = TELEBOY_API_URL;
+
+static const RetryPolicy DEFAULT_RETRY = { 3, 500, 8000 };
+static const RetryPolicy NO_RETRY = { 1, 0, 0 };
+// how long failed responses are cached, by ErrorClass
+static const time_t ERROR_CACHE_DURATIONS[ERROR_CLASS_COUNT] = { 30, 120, 60, 300, 300 };
+static thread_local std::mt19937 randomGenerator(std::random_device{}());
+
+thread_local RequestPriority HttpClient::m_threadPriority = PRIORITY_UI;
 
 HttpClient::HttpClient(ParameterDB *parameterDB):
-  m_parameterDB(parameterDB)
+  m_parameterDB(parameterDB),
+  m_rateLimiter(std::make_shared<RateLimiter>()),
+  m_circuitBreaker(std::make_shared<CircuitBreaker>(5, 30))
 {
-  kodi::Log(ADDON_LOG_INFO, "Using useragent: %s", USER_AGENT.c_str());
+  if (m_parameterDB != nullptr)
+  {
+    m_cinergyS = m_parameterDB->Get("cinergy_s");
+  }
+}
 
-  m_cinergyS = m_parameterDB->Get("cinergy_s");
+HttpClient::HttpClient(HttpClient& shared):
+  m_parameterDB(nullptr),
+  m_rateLimiter(shared.m_rateLimiter),
+  m_circuitBreaker(shared.m_circuitBreaker)
+{
+  std::lock_guard<std::mutex> lock(shared.m_mutex);
+  m_retryPolicies = shared.m_retryPolicies;
+}
+
+std::string HttpClient::GetUserAgent()
+{
+  return USER_AGENT;
 }
 
 HttpClient::~HttpClient()
@@ -25,29 +55,87 @@ HttpClient::~HttpClient()
 }
 
 void HttpClient::ClearSession() {
+  std::lock_guard<std::mutex> lock(m_mutex);
   m_cinergyS = "";
-  m_parameterDB->Set("cinergy_s", m_cinergyS);
+  if (m_parameterDB != nullptr)
+  {
+    m_parameterDB->Set("cinergy_s", m_cinergyS);
+  }
   m_apiKey = "";  
 }
 
-std::string HttpClient::HttpGetCached(const std::string& url, time_t cacheDuration, int &statusCode)
+// Takes over cookie, api key and headers of another client, e.g. of the one
+// a session was refreshed with.
+void HttpClient::AdoptSession(HttpClient& other) {
+  std::scoped_lock lock(m_mutex, other.m_mutex);
+  m_headers = other.m_headers;
+  m_apiKey = other.m_apiKey;
+  if (!other.m_cinergyS.empty() && other.m_cinergyS != m_cinergyS)
+  {
+    m_cinergyS = other.m_cinergyS;
+    if (m_parameterDB != nullptr)
+    {
+      m_parameterDB->Set("cinergy_s", m_cinergyS);
+    }
+  }
+}
+
+bool HttpClient::ReadCached(const std::string& url, CacheEntry& entry, int &statusCode)
 {
+  return Cache::Read(url, entry, statusCode);
+}
 
-  std::string content;
-  std::string cacheKey = md5(url);
-  statusCode = 200;
-  if (!Cache::Read(cacheKey, content))
+void HttpClient::CacheResponse(const std::string& url, const std::string& content,
+    int statusCode, bool valid, time_t cacheDuration)
+{
+  time_t validUntil;
+  time(&validUntil);
+  if (valid)
+  {
+    validUntil += cacheDuration;
+  }
+  else
   {
-    content = HttpGet(url, statusCode);
-    if (!content.empty())
+    ErrorClass errorClass;
+    if (!GetErrorClass(statusCode, errorClass))
     {
-      time_t validUntil;
-      time(&validUntil);
-      validUntil += cacheDuration;
-      Cache::Write(cacheKey, content, validUntil);
+      return;
     }
+    validUntil += std::min(ERROR_CACHE_DURATIONS[errorClass], cacheDuration);
+    kodi::Log(ADDON_LOG_DEBUG, "Caching failed response (%i) for %s.", statusCode,
+        url.c_str());
   }
-  return content;
+  Cache::Write(url, content, validUntil, statusCode);
+}
+
+bool HttpClient::GetErrorClass(int statusCode, ErrorClass& errorClass)
+{
+  // an open circuit and an expired session clear up independently of the url
+  if (statusCode == STATUS_CIRCUIT_OPEN || statusCode == 401 || statusCode == 403)
+  {
+    return false;
+  }
+  if (statusCode < 0)
+  {
+    errorClass = ERROR_NETWORK;
+  }
+  else if (statusCode == 429)
+  {
+    errorClass = ERROR_RATE_LIMITED;
+  }
+  else if (statusCode >= 500)
+  {
+    errorClass = ERROR_SERVER;
+  }
+  else if (statusCode >= 400)
+  {
+    errorClass = ERROR_CLIENT;
+  }
+  else
+  {
+    errorClass = ERROR_API;
+  }
+  return true;
 }
 
 std::string HttpClient::HttpGet(const std::string& url, int &statusCode)
@@ -66,11 +154,95 @@ std::string HttpClient::HttpPost(const std::string& url, const std::string& post
 }
 
 std::string HttpClient::HttpRequest(const std::string& action, const std::string& url, const std::string& postData, int &statusCode)
+{
+  // only idempotent requests are retried
+  RetryPolicy policy = action == "GET" ? GetRetryPolicy(url) : NO_RETRY;
+  std::string content;
+  for (int attempt = 1; ; attempt++)
+  {
+    int retryAfter = -1;
+    content = HttpRequestAttempt(action, url, postData, statusCode, retryAfter);
+    if (!IsRetryable(statusCode) || attempt >= policy.maxAttempts)
+    {
+      break;
+    }
+    int delayMs = std::min(policy.baseDelayMs << (attempt - 1), policy.maxDelayMs);
+    delayMs = delayMs / 2 + std::uniform_int_distribution<int>(0, delayMs / 2)(randomGenerator);
+    if (retryAfter >= 0)
+    {
+      if (retryAfter * 1000 > policy.maxDelayMs)
+      {
+        kodi::Log(ADDON_LOG_INFO, "Not retrying, server asked to wait %i s.", retryAfter);
+        break;
+      }
+      delayMs = std::max(delayMs, retryAfter * 1000);
+    }
+    kodi::Log(ADDON_LOG_INFO, "Request failed with %i. Retry %i of %i in %i ms.",
+        statusCode, attempt, policy.maxAttempts - 1, delayMs);
+    std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+  }
+
+  if (statusCode >= 400 || statusCode < 200) {
+    kodi::Log(ADDON_LOG_ERROR, "Open URL failed with %i.", statusCode);
+    if (m_statusCodeHandler != nullptr) {
+      m_statusCodeHandler->ErrorStatusCode(statusCode);
+    }
+  }
+  return content;
+}
+
+RetryPolicy HttpClient::GetRetryPolicy(const std::string& url)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto& entry : m_retryPolicies)
+  {
+    if (url.find(entry.first) != std::string::npos)
+    {
+      return entry.second;
+    }
+  }
+  return DEFAULT_RETRY;
+}
+
+bool HttpClient::IsRetryable(int statusCode)
+{
+  return (statusCode < 0 && statusCode != STATUS_CIRCUIT_OPEN) || statusCode == 429 || statusCode == 500
+      || statusCode == 502 || statusCode == 503 || statusCode == 504;
+}
+
+void HttpClient::SetRateLimit(const std::string& urlPattern, double ratePerSecond, double burst)
+{
+  m_rateLimiter->AddBucket(urlPattern, ratePerSecond, burst);
+}
+
+void HttpClient::SetThreadPriority(RequestPriority priority)
+{
+  m_threadPriority = priority;
+}
+
+RequestPriority HttpClient::GetPriority(const std::string& url)
+{
+  if (m_threadPriority == PRIORITY_UI && url.find("/stream/") != std::string::npos)
+  {
+    return PRIORITY_PLAYBACK;
+  }
+  return m_threadPriority;
+}
+
+void HttpClient::SetRetryPolicy(const std::string& urlPattern, const RetryPolicy& policy)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_retryPolicies.emplace_back(urlPattern, policy);
+}
+
+std::string HttpClient::HttpRequestAttempt(const std::string& action, const std::string& url,
+    const std::string& postData, int &statusCode, int &retryAfter)
 {
   Curl curl;
 
   curl.AddOption("acceptencoding", "gzip,deflate");
   
+  std::unique_lock<std::mutex> lock(m_mutex);
   for (auto const &entry : m_headers)
   {
     curl.AddHeader(entry.first.c_str(), entry.second);
@@ -78,7 +250,7 @@ std::string HttpClient::HttpRequest(const std::string& action, const std::string
   
   if (!m_cinergyS.empty())
   {
-    if (url.find("tv.api.teleboy.ch") != std::string::npos) {
+    if (url.compare(0, apiUrl.size(), apiUrl) == 0) {
      curl.AddHeader("x-teleboy-session", m_cinergyS);
     } else {
      curl.AddOption("cookie", "cinergy_s=" + m_cinergyS);
@@ -88,28 +260,56 @@ std::string HttpClient::HttpRequest(const std::string& action, const std::string
   {
     curl.AddHeader("x-teleboy-apikey", m_apiKey);
   }
+  lock.unlock();
 
   curl.AddHeader("x-teleboy-device-type", apiDeviceType);
   curl.AddHeader("x-teleboy-version", apiVersion);
   
   curl.AddHeader("User-Agent", USER_AGENT);
 
+  if (!m_circuitBreaker->AllowRequest(url))
+  {
+    kodi::Log(ADDON_LOG_DEBUG, "Skipping request to %s due to open circuit.", url.c_str());
+    statusCode = STATUS_CIRCUIT_OPEN;
+    return "";
+  }
+
+  m_rateLimiter->Acquire(url, GetPriority(url));
+
+  auto start = std::chrono::steady_clock::now();
   std::string content = HttpRequestToCurl(curl, action, url, postData, statusCode);
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  HttpStatistics::RecordRequest(url, duration.count(), content.size(), statusCode);
+
+  bool circuitOpen;
+  if (m_circuitBreaker->RecordResult(url, statusCode >= 0 && statusCode < 500, circuitOpen)
+      && m_statusCodeHandler != nullptr)
+  {
+    m_statusCodeHandler->CircuitStateChanged(circuitOpen);
+  }
   
+  lock.lock();
   m_location = curl.GetLocation();
+  lock.unlock();
 
   if (statusCode >= 400 || statusCode < 200) {
-    kodi::Log(ADDON_LOG_ERROR, "Open URL failed with %i.", statusCode);
-    if (m_statusCodeHandler != nullptr) {
-      m_statusCodeHandler->ErrorStatusCode(statusCode);
+    std::string retryAfterHeader = curl.GetRetryAfter();
+    if (!retryAfterHeader.empty() && isdigit(retryAfterHeader[0]))
+    {
+      retryAfter = atoi(retryAfterHeader.c_str());
     }
     return content;
   }
   std::string cinergys = curl.GetCookie("cinergy_s");
+  lock.lock();
   if (!cinergys.empty() && cinergys != m_cinergyS && cinergys != "deleted")
   {
     m_cinergyS = cinergys;
-    m_parameterDB->Set("cinergy_s", m_cinergyS);
+    if (m_parameterDB != nullptr)
+    {
+      m_parameterDB->Set("cinergy_s", m_cinergyS);
+    }
   }
 
   return content;
@@ -138,10 +338,12 @@ std::string HttpClient::HttpRequestToCurl(Curl &curl, const std::string& action,
 
 void HttpClient::AddHeader(const std::string& name, const std::string& value)
 {
+  std::lock_guard<std::mutex> lock(m_mutex);
   m_headers[name] = value;
 }
 
 void HttpClient::ResetHeaders()
 {
+  std::lock_guard<std::mutex> lock(m_mutex);
   m_headers.clear();
 }
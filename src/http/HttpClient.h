@@ -2,33 +2,78 @@
 #define SRC_HTTP_HTTPCLIENT_H_
 
 #include "Curl.h"
+#include "Cache.h"
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "../sql/ParameterDB.h"
 #include "HttpStatusCodeHandler.h"
+#include "RateLimiter.h"
+#include "CircuitBreaker.h"
+
+// status code of requests which were not sent due to an open circuit
+static const int STATUS_CIRCUIT_OPEN = -3;
+
+// failed responses are cached for a duration depending on their class
+enum ErrorClass
+{
+  ERROR_NETWORK,
+  ERROR_RATE_LIMITED,
+  ERROR_SERVER,
+  ERROR_CLIENT,
+  ERROR_API,
+  ERROR_CLASS_COUNT
+};
+
+struct RetryPolicy
+{
+  int maxAttempts;
+  int baseDelayMs;
+  int maxDelayMs;
+};
 
 class HttpClient
 {
 public:
+  // without a parameter db the session cookie is not persisted
   HttpClient(ParameterDB *parameterDB);
+  // shares rate limits, circuits and retry policies with another client,
+  // without persisting the session cookie
+  explicit HttpClient(HttpClient& shared);
   ~HttpClient();
-  std::string HttpGetCached(const std::string& url, time_t cacheDuration, int &statusCode);
+  bool ReadCached(const std::string& url, CacheEntry& entry, int &statusCode);
+  void CacheResponse(const std::string& url, const std::string& content, int statusCode,
+      bool valid, time_t cacheDuration);
   std::string HttpGet(const std::string& url, int &statusCode);
   std::string HttpDelete(const std::string& url, int &statusCode);
   std::string HttpPost(const std::string& url, const std::string& postData, int &statusCode);
   void ClearSession();
+  void AdoptSession(HttpClient& other);
   void AddHeader(const std::string& name, const std::string& value);
   void ResetHeaders();
   std::string GetLocation() {
+    std::lock_guard<std::mutex> lock(m_mutex);
     return m_location;
   }
   void SetApiKey(const std::string& apiKey) {
+    std::lock_guard<std::mutex> lock(m_mutex);
     m_apiKey = apiKey;
   }
+  void SetRetryPolicy(const std::string& urlPattern, const RetryPolicy& policy);
+  void SetRateLimit(const std::string& urlPattern, double ratePerSecond, double burst);
+  static void SetThreadPriority(RequestPriority priority);
+  static std::string GetUserAgent();
   void SetStatusCodeHandler(HttpStatusCodeHandler* statusCodeHandler) {
     m_statusCodeHandler = statusCodeHandler;
   }
 
 private:
   std::string HttpRequest(const std::string& action, const std::string& url, const std::string& postData, int &statusCode);
+  std::string HttpRequestAttempt(const std::string& action, const std::string& url, const std::string& postData, int &statusCode, int &retryAfter);
+  RetryPolicy GetRetryPolicy(const std::string& url);
+  static bool IsRetryable(int statusCode);
+  static bool GetErrorClass(int statusCode, ErrorClass& errorClass);
+  static RequestPriority GetPriority(const std::string& url);
   std::string HttpRequestToCurl(Curl &curl, const std::string& action, const std::string& url, const std::string& postData, int &statusCode);
   std::string GenerateUUID();
   std::string m_apiKey;
@@ -37,6 +82,12 @@ private:
   std::map<std::string, std::string> m_headers;
   std::string m_location;
   HttpStatusCodeHandler *m_statusCodeHandler = nullptr;
+  std::vector<std::pair<std::string, RetryPolicy>> m_retryPolicies;
+  // shared with the clients created from this one
+  std::shared_ptr<RateLimiter> m_rateLimiter;
+  std::shared_ptr<CircuitBreaker> m_circuitBreaker;
+  static thread_local RequestPriority m_threadPriority;
+  std::mutex m_mutex;
 };
 
 #endif /* SRC_HTTP_HTTPCLIENT_H_ */
@@ -0,0 +1,251 @@
+#include "HttpStatistics.h"
+#include <kodi/AddonBase.h>
+#include "../Utils.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+
+using namespace rapidjson;
+
+constexpr char STATISTICS_FILE[] = "special://profile/addon_data/pvr.teleboy/http_statistics.json";
+constexpr time_t DUMP_INTERVAL = 15 * 60;
+// upper bounds of the latency buckets in ms, the last bucket takes the rest
+constexpr uint64_t LATENCY_BUCKETS[EndpointStatistics::BUCKET_COUNT - 1] =
+    { 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000 };
+
+std::mutex HttpStatistics::m_mutex;
+std::map<std::string, EndpointStatistics> HttpStatistics::m_endpoints;
+std::map<int, uint64_t> HttpStatistics::m_statusCodes;
+CacheStatistics HttpStatistics::m_cache;
+time_t HttpStatistics::m_lastDump = 0;
+
+void HttpStatistics::RecordRequest(const std::string& url, uint64_t durationMs,
+    size_t bytes, int statusCode)
+{
+  std::string endpoint = GetEndpoint(url);
+  int bucket = 0;
+  while (bucket < EndpointStatistics::BUCKET_COUNT - 1
+      && durationMs > LATENCY_BUCKETS[bucket])
+  {
+    bucket++;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  EndpointStatistics& stats = m_endpoints[endpoint];
+  stats.requests++;
+  if (statusCode >= 400 || statusCode < 200)
+  {
+    stats.errors++;
+  }
+  stats.bytes += bytes;
+  stats.totalMs += durationMs;
+  if (durationMs > stats.maxMs)
+  {
+    stats.maxMs = durationMs;
+  }
+  stats.latencyBuckets[bucket]++;
+  m_statusCodes[statusCode]++;
+}
+
+void HttpStatistics::RecordCacheHit()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cache.hits++;
+}
+
+void HttpStatistics::RecordCacheMiss()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cache.misses++;
+}
+
+void HttpStatistics::RecordCacheStale()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cache.stale++;
+}
+
+void HttpStatistics::RecordCacheOccupancy(uint64_t bytes, uint64_t entries,
+    uint64_t capacity)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cache.bytes = bytes;
+  m_cache.entries = entries;
+  m_cache.capacity = capacity;
+}
+
+void HttpStatistics::RecordCacheEvictions(uint64_t evictions)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cache.evictions += evictions;
+}
+
+void HttpStatistics::Dump()
+{
+  time_t currTime;
+  time(&currTime);
+  CacheStatistics cache;
+  std::map<std::string, EndpointStatistics> endpoints;
+  std::map<int, uint64_t> statusCodes;
+  {
+    // take a copy, so that the requests are not blocked while writing the file
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_lastDump == 0)
+    {
+      m_lastDump = currTime;
+      return;
+    }
+    if (m_lastDump + DUMP_INTERVAL > currTime)
+    {
+      return;
+    }
+    m_lastDump = currTime;
+    cache = m_cache;
+    endpoints = m_endpoints;
+    statusCodes = m_statusCodes;
+  }
+
+  kodi::Log(ADDON_LOG_INFO, "Http statistics: cache hits: %llu, misses: %llu, stale: %llu",
+      static_cast<unsigned long long>(cache.hits),
+      static_cast<unsigned long long>(cache.misses),
+      static_cast<unsigned long long>(cache.stale));
+  kodi::Log(ADDON_LOG_INFO,
+      "Http statistics: cache size: %llu of %llu bytes, entries: %llu, evictions: %llu",
+      static_cast<unsigned long long>(cache.bytes),
+      static_cast<unsigned long long>(cache.capacity),
+      static_cast<unsigned long long>(cache.entries),
+      static_cast<unsigned long long>(cache.evictions));
+  for (const auto& entry : endpoints)
+  {
+    const EndpointStatistics& stats = entry.second;
+    kodi::Log(ADDON_LOG_INFO,
+        "Http statistics: %s: requests: %llu, errors: %llu, bytes: %llu, avg: %llu ms, max: %llu ms",
+        entry.first.c_str(), static_cast<unsigned long long>(stats.requests),
+        static_cast<unsigned long long>(stats.errors),
+        static_cast<unsigned long long>(stats.bytes),
+        static_cast<unsigned long long>(stats.totalMs / stats.requests),
+        static_cast<unsigned long long>(stats.maxMs));
+  }
+  for (const auto& entry : statusCodes)
+  {
+    kodi::Log(ADDON_LOG_INFO, "Http statistics: status %i: %llu", entry.first,
+        static_cast<unsigned long long>(entry.second));
+  }
+  WriteJson(cache, endpoints, statusCodes);
+}
+
+std::string HttpStatistics::GetEndpoint(const std::string& url)
+{
+  std::string::size_type begin = url.find("://");
+  begin = begin == std::string::npos ? 0 : begin + 3;
+  std::string::size_type end = url.find('?', begin);
+  if (end == std::string::npos)
+  {
+    end = url.size();
+  }
+
+  // replace ids in the path, so that all requests of a kind are grouped
+  std::string endpoint;
+  endpoint.reserve(end - begin);
+  std::string::size_type pos = begin;
+  while (pos < end)
+  {
+    std::string::size_type next = url.find('/', pos);
+    if (next == std::string::npos || next > end)
+    {
+      next = end;
+    }
+    bool isId = next > pos;
+    for (std::string::size_type i = pos; i < next && isId; i++)
+    {
+      isId = url[i] >= '0' && url[i] <= '9';
+    }
+    if (isId)
+    {
+      endpoint += '*';
+    }
+    else
+    {
+      endpoint.append(url, pos, next - pos);
+    }
+    if (next < end)
+    {
+      endpoint += '/';
+    }
+    pos = next + 1;
+  }
+  return endpoint;
+}
+
+void HttpStatistics::WriteJson(const CacheStatistics& cache,
+    const std::map<std::string, EndpointStatistics>& endpoints,
+    const std::map<int, uint64_t>& statusCodes)
+{
+  StringBuffer buffer;
+  Writer<StringBuffer> writer(buffer);
+  writer.StartObject();
+  writer.Key("cache");
+  writer.StartObject();
+  writer.Key("hits");
+  writer.Uint64(cache.hits);
+  writer.Key("misses");
+  writer.Uint64(cache.misses);
+  writer.Key("stale");
+  writer.Uint64(cache.stale);
+  writer.Key("bytes");
+  writer.Uint64(cache.bytes);
+  writer.Key("capacity");
+  writer.Uint64(cache.capacity);
+  writer.Key("entries");
+  writer.Uint64(cache.entries);
+  writer.Key("evictions");
+  writer.Uint64(cache.evictions);
+  writer.EndObject();
+
+  writer.Key("latencyBucketsMs");
+  writer.StartArray();
+  for (uint64_t bound : LATENCY_BUCKETS)
+  {
+    writer.Uint64(bound);
+  }
+  writer.EndArray();
+
+  writer.Key("endpoints");
+  writer.StartObject();
+  for (const auto& entry : endpoints)
+  {
+    const EndpointStatistics& stats = entry.second;
+    writer.Key(entry.first.c_str());
+    writer.StartObject();
+    writer.Key("requests");
+    writer.Uint64(stats.requests);
+    writer.Key("errors");
+    writer.Uint64(stats.errors);
+    writer.Key("bytes");
+    writer.Uint64(stats.bytes);
+    writer.Key("totalMs");
+    writer.Uint64(stats.totalMs);
+    writer.Key("maxMs");
+    writer.Uint64(stats.maxMs);
+    writer.Key("latency");
+    writer.StartArray();
+    for (uint64_t count : stats.latencyBuckets)
+    {
+      writer.Uint64(count);
+    }
+    writer.EndArray();
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  writer.Key("statusCodes");
+  writer.StartObject();
+  for (const auto& entry : statusCodes)
+  {
+    writer.Key(std::to_string(entry.first).c_str());
+    writer.Uint64(entry.second);
+  }
+  writer.EndObject();
+  writer.EndObject();
+
+  Utils::WriteFile(STATISTICS_FILE, buffer.GetString(), buffer.GetSize());
+}
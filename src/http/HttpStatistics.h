@@ -0,0 +1,52 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <ctime>
+#include <cstdint>
+
+struct EndpointStatistics
+{
+  static const int BUCKET_COUNT = 10;
+  uint64_t requests = 0;
+  uint64_t errors = 0;
+  uint64_t bytes = 0;
+  uint64_t totalMs = 0;
+  uint64_t maxMs = 0;
+  uint64_t latencyBuckets[BUCKET_COUNT] = {};
+};
+
+struct CacheStatistics
+{
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t stale = 0;
+  uint64_t bytes = 0;
+  uint64_t entries = 0;
+  uint64_t capacity = 0;
+  uint64_t evictions = 0;
+};
+
+class HttpStatistics
+{
+public:
+  static void RecordRequest(const std::string& url, uint64_t durationMs,
+      size_t bytes, int statusCode);
+  static void RecordCacheHit();
+  static void RecordCacheMiss();
+  static void RecordCacheStale();
+  static void RecordCacheOccupancy(uint64_t bytes, uint64_t entries, uint64_t capacity);
+  static void RecordCacheEvictions(uint64_t evictions);
+  static void Dump();
+private:
+  static std::string GetEndpoint(const std::string& url);
+  static void WriteJson(const CacheStatistics& cache,
+      const std::map<std::string, EndpointStatistics>& endpoints,
+      const std::map<int, uint64_t>& statusCodes);
+  static std::mutex m_mutex;
+  static std::map<std::string, EndpointStatistics> m_endpoints;
+  static std::map<int, uint64_t> m_statusCodes;
+  static CacheStatistics m_cache;
+  static time_t m_lastDump;
+};
@@ -6,6 +6,7 @@ class HttpStatusCodeHandler
 {
     public:
     virtual void ErrorStatusCode (int statusCode) {};
+    virtual void CircuitStateChanged (bool open) {};
     virtual ~HttpStatusCodeHandler() {};
 };
 
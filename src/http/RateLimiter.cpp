@@ -0,0 +1,64 @@
+#include "RateLimiter.h"
+#include <algorithm>
+#include <thread>
+
+// share of a bucket which is reserved for higher priorities
+static const double RESERVED_SHARE[] = { 0.0, 0.25, 0.5 };
+
+void RateLimiter::AddBucket(const std::string& urlPattern, double ratePerSecond, double burst)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Bucket bucket;
+  bucket.urlPattern = urlPattern;
+  bucket.rate = ratePerSecond;
+  bucket.burst = std::max(burst, 1.0);
+  bucket.tokens = bucket.burst;
+  bucket.lastRefill = std::chrono::steady_clock::now();
+  m_buckets.push_back(bucket);
+}
+
+double RateLimiter::Reserve(const Bucket& bucket, RequestPriority priority)
+{
+  return RESERVED_SHARE[priority] * (bucket.burst - 1);
+}
+
+void RateLimiter::Acquire(const std::string& url, RequestPriority priority)
+{
+  while (true)
+  {
+    double waitSeconds = 0;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto now = std::chrono::steady_clock::now();
+      for (Bucket& bucket : m_buckets)
+      {
+        if (url.find(bucket.urlPattern) == std::string::npos)
+        {
+          continue;
+        }
+        std::chrono::duration<double> elapsed = now - bucket.lastRefill;
+        bucket.tokens = std::min(bucket.burst, bucket.tokens + elapsed.count() * bucket.rate);
+        bucket.lastRefill = now;
+        double missing = 1 + Reserve(bucket, priority) - bucket.tokens;
+        if (missing > 0)
+        {
+          waitSeconds = std::max(waitSeconds, missing / bucket.rate);
+        }
+      }
+      if (waitSeconds == 0)
+      {
+        for (Bucket& bucket : m_buckets)
+        {
+          if (url.find(bucket.urlPattern) != std::string::npos)
+          {
+            bucket.tokens -= 1;
+          }
+        }
+        return;
+      }
+    }
+    // wake up regularly, since other requests compete for the same tokens
+    waitSeconds = std::min(std::max(waitSeconds, 0.01), 1.0);
+    std::this_thread::sleep_for(std::chrono::duration<double>(waitSeconds));
+  }
+}
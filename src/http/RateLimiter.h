@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum RequestPriority
+{
+  PRIORITY_PLAYBACK = 0,
+  PRIORITY_UI = 1,
+  PRIORITY_BACKGROUND = 2
+};
+
+// Token buckets shared by all requests. Lower priorities leave a part of
+// each bucket untouched, so they automatically yield to interactive calls.
+class RateLimiter
+{
+public:
+  void AddBucket(const std::string& urlPattern, double ratePerSecond, double burst);
+  void Acquire(const std::string& url, RequestPriority priority);
+private:
+  struct Bucket
+  {
+    std::string urlPattern;
+    double rate;
+    double burst;
+    double tokens;
+    std::chrono::steady_clock::time_point lastRefill;
+  };
+  static double Reserve(const Bucket& bucket, RequestPriority priority);
+  std::vector<Bucket> m_buckets;
+  std::mutex m_mutex;
+};
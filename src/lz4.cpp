@@ -0,0 +1,174 @@
+#include "lz4.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+static const size_t MIN_MATCH = 4;
+// the last match has to start at least 12 bytes before the end of the block
+static const size_t MF_LIMIT = 12;
+// the last 5 bytes are always literals
+static const size_t LAST_LITERALS = 5;
+static const size_t MAX_OFFSET = 65535;
+static const int HASH_BITS = 14;
+// a block can not expand to more than about 255 times its size
+static const size_t MAX_EXPANSION = 255;
+
+static inline uint32_t Read32(const char* p)
+{
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint32_t Hash(uint32_t sequence)
+{
+  return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static void WriteLength(std::string& dst, size_t length)
+{
+  while (length >= 255)
+  {
+    dst += static_cast<char>(255);
+    length -= 255;
+  }
+  dst += static_cast<char>(length);
+}
+
+static void WriteSequence(std::string& dst, const char* literals, size_t literalLength,
+    size_t offset, size_t matchLength)
+{
+  size_t matchCode = matchLength - MIN_MATCH;
+  unsigned char token = static_cast<unsigned char>(
+      ((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+  dst += static_cast<char>(token);
+  if (literalLength >= 15)
+  {
+    WriteLength(dst, literalLength - 15);
+  }
+  dst.append(literals, literalLength);
+  dst += static_cast<char>(offset & 0xff);
+  dst += static_cast<char>(offset >> 8);
+  if (matchCode >= 15)
+  {
+    WriteLength(dst, matchCode - 15);
+  }
+}
+
+std::string LZ4Compress(const char* src, size_t srcSize)
+{
+  std::string dst;
+  dst.reserve(srcSize / 2 + 16);
+  std::vector<int64_t> table(1 << HASH_BITS, -1);
+
+  size_t anchor = 0;
+  size_t pos = 0;
+  if (srcSize > MF_LIMIT)
+  {
+    size_t matchLimit = srcSize - LAST_LITERALS;
+    while (pos < srcSize - MF_LIMIT)
+    {
+      uint32_t sequence = Read32(src + pos);
+      uint32_t hash = Hash(sequence);
+      int64_t ref = table[hash];
+      table[hash] = static_cast<int64_t>(pos);
+      if (ref < 0 || pos - ref > MAX_OFFSET || Read32(src + ref) != sequence)
+      {
+        pos++;
+        continue;
+      }
+
+      size_t matchLength = MIN_MATCH;
+      while (pos + matchLength < matchLimit && src[ref + matchLength] == src[pos + matchLength])
+      {
+        matchLength++;
+      }
+      WriteSequence(dst, src + anchor, pos - anchor, pos - ref, matchLength);
+      pos += matchLength;
+      anchor = pos;
+    }
+  }
+
+  // the last sequence only consists of literals
+  size_t literalLength = srcSize - anchor;
+  dst += static_cast<char>((literalLength < 15 ? literalLength : 15) << 4);
+  if (literalLength >= 15)
+  {
+    WriteLength(dst, literalLength - 15);
+  }
+  dst.append(src + anchor, literalLength);
+  return dst;
+}
+
+static bool ReadLength(const unsigned char*& in, const unsigned char* end, size_t& length)
+{
+  unsigned char byte;
+  do
+  {
+    if (in >= end)
+    {
+      return false;
+    }
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+bool LZ4Decompress(const char* src, size_t srcSize, size_t decompressedSize,
+    std::string& dst)
+{
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+  const unsigned char* end = in + srcSize;
+  // the size comes from outside, do not trust it with the allocation
+  if (decompressedSize > srcSize * MAX_EXPANSION)
+  {
+    return false;
+  }
+  dst.resize(decompressedSize);
+  size_t out = 0;
+
+  while (in < end)
+  {
+    unsigned char token = *in++;
+    size_t literalLength = token >> 4;
+    if (literalLength == 15 && !ReadLength(in, end, literalLength))
+    {
+      return false;
+    }
+    if (literalLength > static_cast<size_t>(end - in) || literalLength > decompressedSize - out)
+    {
+      return false;
+    }
+    memcpy(&dst[out], in, literalLength);
+    in += literalLength;
+    out += literalLength;
+    if (in == end)
+    {
+      break;
+    }
+
+    if (end - in < 2)
+    {
+      return false;
+    }
+    size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    size_t matchLength = token & 0x0f;
+    if (matchLength == 15 && !ReadLength(in, end, matchLength))
+    {
+      return false;
+    }
+    matchLength += MIN_MATCH;
+    if (offset == 0 || offset > out || matchLength > decompressedSize - out)
+    {
+      return false;
+    }
+    // matches may overlap with the bytes they produce
+    for (size_t i = 0; i < matchLength; i++, out++)
+    {
+      dst[out] = dst[out - offset];
+    }
+  }
+  return out == decompressedSize;
+}
@@ -0,0 +1,18 @@
+/*
+ * Implementation of the LZ4 block format by Yann Collet.
+ * https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ *
+ * A fast compression with a simple greedy match finder, used to shrink
+ * cache entries.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+std::string LZ4Compress(const char* src, size_t srcSize);
+
+// returns false if the input is not a valid block of decompressedSize bytes
+bool LZ4Decompress(const char* src, size_t srcSize, size_t decompressedSize,
+    std::string& dst);
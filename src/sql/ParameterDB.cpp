@@ -2,20 +2,19 @@
 
 const int DB_VERSION = 1;
 
-class ProcessParameterRowCallback : public ProcessRowCallback {
+class ProcessParametersRowCallback : public ProcessRowCallback {
 public:
-  virtual ~ProcessParameterRowCallback() { }
-  
-  void ProcessRow(sqlite3_stmt* stmt) {
-    m_result = std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+  ProcessParametersRowCallback(std::map<std::string, std::string>& values):
+    m_values(values) {
   }
+  virtual ~ProcessParametersRowCallback() { }
   
-  std::string Result() {
-    return m_result;
+  void ProcessRow(sqlite3_stmt* stmt) {
+    m_values[ColumnString(stmt, 0)] = ColumnString(stmt, 1);
   }
   
 private:
-  std::string m_result = "";
+  std::map<std::string, std::string>& m_values;
 };
 
 ParameterDB::ParameterDB(std::string folder)
@@ -25,11 +24,20 @@ ParameterDB::ParameterDB(std::string folder)
   if (!MigrateDbIfRequired()) {
     kodi::Log(ADDON_LOG_ERROR, "%s: Failed to migrate DB to version: %i", m_name.c_str(), DB_VERSION);
   }
+  LoadParameters();
 }
 
 ParameterDB::~ParameterDB() {
 }
 
+void ParameterDB::LoadParameters() {
+  std::lock_guard<std::mutex> lock(m_valuesMutex);
+  ProcessParametersRowCallback callback(m_values);
+  if (!Query("select KEY, VALUE from PARAMETER", callback)) {
+    kodi::Log(ADDON_LOG_ERROR, "%s: Failed to load parameters from db.", m_name.c_str());
+  }
+}
+
 bool ParameterDB::MigrateDbIfRequired() {
   int currentVersion = GetVersion();
   while (currentVersion < DB_VERSION) {
@@ -62,21 +70,23 @@ bool ParameterDB::Migrate0To1() {
 }
 
 bool ParameterDB::Set(std::string key, std::string value) {
-  std::string insert = "replace into PARAMETER VALUES ";
-  insert += "('" + key + "','" + value + "')";
-  
-  if (!Execute(insert)) {
-    kodi::Log(ADDON_LOG_ERROR, "%s: Failed to insert", m_name.c_str());
-    return false;
+  std::lock_guard<std::mutex> lock(m_valuesMutex);
+  auto it = m_values.find(key);
+  if (it != m_values.end() && it->second == value) {
+    return true;
   }
+  m_values[key] = value;
+  // queued under the lock, so the writes reach the db in the order of memory
+  Write("replace into PARAMETER VALUES (?, ?)", { key, value });
   return true;
 }
 
 std::string ParameterDB::Get(std::string key) {
-  ProcessParameterRowCallback callback;
-  if (!Query("select VALUE from PARAMETER where KEY = '" + key + "'", callback)) {
-    kodi::Log(ADDON_LOG_ERROR, "%s: Failed to get parameter from db.", m_name.c_str());
+  std::lock_guard<std::mutex> lock(m_valuesMutex);
+  auto it = m_values.find(key);
+  if (it == m_values.end()) {
+    return "";
   }
-  return callback.Result();
+  return it->second;
 }
 
@@ -2,6 +2,7 @@
 #define SRC_SQL_PARAMETERDB_H_
 
 #include "SQLConnection.h"
+#include <map>
 
 class ParameterDB : public SQLConnection
 {
@@ -13,6 +14,9 @@ public:
 private:
   bool MigrateDbIfRequired();
   bool Migrate0To1();
+  void LoadParameters();
+  std::map<std::string, std::string> m_values;
+  std::mutex m_valuesMutex;
 };
 
 #endif /* SRC_SQL_PARAMETERDB_H_ */
@@ -1,11 +1,61 @@
 #include "SQLConnection.h"
+#include <chrono>
+
+// number of connections serving queries in parallel
+static const size_t MAX_READERS = 3;
+static const int BUSY_TIMEOUT_MS = 5000;
+// writes within this delay are written in one transaction
+static const int WRITE_BATCH_DELAY_MS = 500;
+
+std::string ProcessRowCallback::ColumnString(sqlite3_stmt* stmt, int column) {
+  const unsigned char* text = sqlite3_column_text(stmt, column);
+  if (text == nullptr) {
+    return "";
+  }
+  return std::string(reinterpret_cast<const char*>(text), sqlite3_column_bytes(stmt, column));
+}
+
+int ProcessRowCallback::ColumnInt(sqlite3_stmt* stmt, int column) {
+  return sqlite3_column_int(stmt, column);
+}
+
+int64_t ProcessRowCallback::ColumnInt64(sqlite3_stmt* stmt, int column) {
+  return sqlite3_column_int64(stmt, column);
+}
+
+SQLValue::SQLValue(const std::string& value):
+    m_isText(true),
+    m_text(value) {
+}
+
+SQLValue::SQLValue(const char* value):
+    m_isText(true),
+    m_text(value) {
+}
+
+SQLValue::SQLValue(int64_t value):
+    m_isText(false),
+    m_integer(value) {
+}
+
+SQLValue::SQLValue(int value):
+    m_isText(false),
+    m_integer(value) {
+}
+
+int SQLValue::Bind(sqlite3_stmt* stmt, int index) const {
+  if (m_isText) {
+    return sqlite3_bind_text(stmt, index, m_text.c_str(), m_text.length(), SQLITE_TRANSIENT);
+  }
+  return sqlite3_bind_int64(stmt, index, m_integer);
+}
 
 class ProcessSingleIntRowCallback : public ProcessRowCallback {
 public:
   virtual ~ProcessSingleIntRowCallback() { }
   
   void ProcessRow(sqlite3_stmt* stmt) {
-    m_result = sqlite3_column_int(stmt, 0);
+    m_result = ColumnInt(stmt, 0);
   }
   
   int GetResult() {
@@ -29,31 +79,112 @@ SQLConnection::SQLConnection(std::string name):
 }
 
 SQLConnection::~SQLConnection() {
-  sqlite3_close(m_db);
+  {
+    std::lock_guard<std::mutex> lock(m_writesMutex);
+    m_running = false;
+  }
+  m_writesCondition.notify_all();
+  if (m_writerThread.joinable())
+    m_writerThread.join();
+  FlushWrites();
+  for (SQLHandle* reader : m_readers) {
+    CloseHandle(*reader);
+    delete reader;
+  }
+  CloseHandle(m_writer);
 }
 
 bool SQLConnection::Open(std::string& file) {
-  int rc = sqlite3_open(file.c_str(), &m_db);
-  if(rc) {
-    kodi::Log(ADDON_LOG_ERROR, "%s: Can't open database: %s", m_name.c_str(), sqlite3_errmsg(m_db));
+  m_file = file;
+  if (!OpenHandle(m_writer)) {
     return false;
   }
-  sqlite3_exec(m_db, "PRAGMA synchronous = OFF;", NULL, NULL, NULL);
-  sqlite3_exec(m_db, "PRAGMA journal_mode = OFF;", NULL, NULL, NULL);
+  m_db = m_writer.db;
+  sqlite3_exec(m_db, "PRAGMA journal_mode = WAL;", NULL, NULL, NULL);
+  sqlite3_exec(m_db, "PRAGMA synchronous = NORMAL;", NULL, NULL, NULL);
   EnsureVersionTable();
+  m_running = true;
+  m_writerThread = std::thread([&] { WriterThread(); });
   return true;
 }
 
-bool SQLConnection::Query(std::string query, ProcessRowCallback& callback) {
-  sqlite3_stmt* stmt;
-  int ret = sqlite3_prepare(m_db, query.c_str(), query.length(), &stmt, NULL);
-  
-  if (ret != SQLITE_OK) {
-    sqlite3_finalize(stmt);
-    kodi::Log(ADDON_LOG_ERROR, "%s: Query failed: %s", m_name.c_str(), sqlite3_errmsg(m_db));
+bool SQLConnection::OpenHandle(SQLHandle& handle) {
+  int rc = sqlite3_open_v2(m_file.c_str(), &handle.db,
+      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL);
+  if(rc) {
+    kodi::Log(ADDON_LOG_ERROR, "%s: Can't open database: %s", m_name.c_str(), sqlite3_errmsg(handle.db));
+    sqlite3_close(handle.db);
+    handle.db = nullptr;
+    return false;
+  }
+  sqlite3_busy_timeout(handle.db, BUSY_TIMEOUT_MS);
+  return true;
+}
+
+void SQLConnection::CloseHandle(SQLHandle& handle) {
+  for (auto const &entry : handle.statements) {
+    sqlite3_finalize(entry.second);
+  }
+  handle.statements.clear();
+  sqlite3_close(handle.db);
+  handle.db = nullptr;
+}
+
+SQLHandle* SQLConnection::AcquireReader() {
+  std::unique_lock<std::mutex> lock(m_readersMutex);
+  if (m_idleReaders.empty() && m_readers.size() < MAX_READERS) {
+    SQLHandle* reader = new SQLHandle();
+    if (!OpenHandle(*reader)) {
+      delete reader;
+      return nullptr;
+    }
+    m_readers.push_back(reader);
+    return reader;
+  }
+  m_readersCondition.wait(lock, [this] { return !m_idleReaders.empty(); });
+  SQLHandle* reader = m_idleReaders.back();
+  m_idleReaders.pop_back();
+  return reader;
+}
+
+void SQLConnection::ReleaseReader(SQLHandle* reader) {
+  {
+    std::lock_guard<std::mutex> lock(m_readersMutex);
+    m_idleReaders.push_back(reader);
+  }
+  m_readersCondition.notify_one();
+}
+
+bool SQLConnection::Query(const std::string& query, ProcessRowCallback& callback) {
+  return Query(query, {}, callback);
+}
+
+bool SQLConnection::Query(const std::string& query, const std::vector<SQLValue>& parameters,
+    ProcessRowCallback& callback) {
+  SQLHandle* reader = AcquireReader();
+  if (reader == nullptr) {
+    return false;
+  }
+  bool ret = Run(*reader, query, parameters, callback);
+  ReleaseReader(reader);
+  return ret;
+}
+
+bool SQLConnection::Run(SQLHandle& handle, const std::string& query,
+    const std::vector<SQLValue>& parameters, ProcessRowCallback& callback) {
+  sqlite3_stmt* stmt = GetStatement(handle, query);
+  if (stmt == nullptr) {
     return false;
   }
   
+  for (size_t i = 0; i < parameters.size(); i++) {
+    if (parameters[i].Bind(stmt, i + 1) != SQLITE_OK) {
+      kodi::Log(ADDON_LOG_ERROR, "%s: Binding parameter failed: %s", m_name.c_str(), sqlite3_errmsg(handle.db));
+      sqlite3_clear_bindings(stmt);
+      return false;
+    }
+  }
+  
   bool err = false;
   bool done = false;
   while (!done) {
@@ -67,19 +198,86 @@ bool SQLConnection::Query(std::string query, ProcessRowCallback& callback) {
       break;
 
     default:
-      kodi::Log(ADDON_LOG_ERROR, "%s: Query failed.", m_name.c_str());
+      kodi::Log(ADDON_LOG_ERROR, "%s: Query failed: %s", m_name.c_str(), sqlite3_errmsg(handle.db));
       err = true;
       done = true;
     }
   }
   
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
   return !err;
 }
 
-bool SQLConnection::Execute(std::string query) {
+sqlite3_stmt* SQLConnection::GetStatement(SQLHandle& handle, const std::string& query) {
+  auto it = handle.statements.find(query);
+  if (it != handle.statements.end()) {
+    return it->second;
+  }
+  sqlite3_stmt* stmt;
+  int ret = sqlite3_prepare_v2(handle.db, query.c_str(), query.length(), &stmt, NULL);
+  
+  if (ret != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    kodi::Log(ADDON_LOG_ERROR, "%s: Query failed: %s", m_name.c_str(), sqlite3_errmsg(handle.db));
+    return nullptr;
+  }
+  handle.statements[query] = stmt;
+  return stmt;
+}
+
+bool SQLConnection::Execute(const std::string& query) {
+  return Execute(query, {});
+}
+
+bool SQLConnection::Execute(const std::string& query, const std::vector<SQLValue>& parameters) {
   NoopRowCallback callback;
-  return Query(query, callback);
+  std::lock_guard<std::recursive_mutex> lock(m_writerMutex);
+  return Run(m_writer, query, parameters, callback);
+}
+
+void SQLConnection::Write(const std::string& query, const std::vector<SQLValue>& parameters) {
+  {
+    std::lock_guard<std::mutex> lock(m_writesMutex);
+    m_pendingWrites.push_back({ query, parameters });
+  }
+  m_writesCondition.notify_all();
+}
+
+void SQLConnection::WriterThread() {
+  std::unique_lock<std::mutex> lock(m_writesMutex);
+  while (m_running) {
+    m_writesCondition.wait(lock, [this] { return !m_running || !m_pendingWrites.empty(); });
+    if (!m_running) {
+      break;
+    }
+    // collect writes which follow shortly after into the same transaction
+    m_writesCondition.wait_for(lock, std::chrono::milliseconds(WRITE_BATCH_DELAY_MS),
+        [this] { return !m_running; });
+    lock.unlock();
+    FlushWrites();
+    lock.lock();
+  }
+}
+
+void SQLConnection::FlushWrites() {
+  std::vector<SQLWrite> writes;
+  {
+    std::lock_guard<std::mutex> lock(m_writesMutex);
+    writes.swap(m_pendingWrites);
+  }
+  if (writes.empty() || m_writer.db == nullptr) {
+    return;
+  }
+  NoopRowCallback callback;
+  std::lock_guard<std::recursive_mutex> lock(m_writerMutex);
+  BeginTransaction();
+  for (auto const &write : writes) {
+    if (!Run(m_writer, write.query, write.parameters, callback)) {
+      kodi::Log(ADDON_LOG_ERROR, "%s: Failed to write", m_name.c_str());
+    }
+  }
+  EndTransaction();
 }
 
 bool SQLConnection::EnsureVersionTable() {
@@ -111,14 +309,16 @@ int SQLConnection::GetVersion() {
 }
 
 bool SQLConnection::SetVersion(int newVersion) {
-  return Execute("update SCHEMA_VERSION set VERSION = " + std::to_string(newVersion));
+  return Execute("update SCHEMA_VERSION set VERSION = ?", { newVersion });
 }
 
 void SQLConnection::BeginTransaction() {
+  m_writerMutex.lock();
   sqlite3_exec(m_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
 }
 
 void SQLConnection::EndTransaction() {
   sqlite3_exec(m_db, "END TRANSACTION;", NULL, NULL, NULL);
+  m_writerMutex.unlock();
 }
 
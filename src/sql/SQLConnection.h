@@ -1,6 +1,11 @@
 #pragma once
 
+#include <condition_variable>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include "sqlite/sqlite3.h"
 #include <kodi/AddonBase.h>
 
@@ -8,8 +13,40 @@ class ProcessRowCallback {
 public:
   virtual ~ProcessRowCallback() {};
   virtual void ProcessRow(sqlite3_stmt* stmt) = 0;
+protected:
+  static std::string ColumnString(sqlite3_stmt* stmt, int column);
+  static int ColumnInt(sqlite3_stmt* stmt, int column);
+  static int64_t ColumnInt64(sqlite3_stmt* stmt, int column);
+};
+
+class SQLValue {
+public:
+  SQLValue(const std::string& value);
+  SQLValue(const char* value);
+  SQLValue(int64_t value);
+  SQLValue(int value);
+  int Bind(sqlite3_stmt* stmt, int index) const;
+private:
+  bool m_isText;
+  std::string m_text;
+  int64_t m_integer = 0;
+};
+
+// A sqlite connection together with its prepared statements
+struct SQLHandle {
+  sqlite3* db = nullptr;
+  std::map<std::string, sqlite3_stmt*> statements;
+};
+
+struct SQLWrite {
+  std::string query;
+  std::vector<SQLValue> parameters;
 };
  
+// The database runs in WAL mode. Queries are served by a pool of reader
+// connections, while all writes go through a single writer connection.
+// Writes queued with Write() are executed by a dedicated writer thread in
+// batched transactions.
 class SQLConnection
 {
 public:
@@ -19,8 +56,12 @@ protected:
   SQLConnection(std::string name);
   ~SQLConnection();
   bool Open(std::string& file);
-  bool Query(std::string query, ProcessRowCallback& callback);
-  bool Execute(std::string query);
+  bool Query(const std::string& query, ProcessRowCallback& callback);
+  bool Query(const std::string& query, const std::vector<SQLValue>& parameters,
+      ProcessRowCallback& callback);
+  bool Execute(const std::string& query);
+  bool Execute(const std::string& query, const std::vector<SQLValue>& parameters);
+  void Write(const std::string& query, const std::vector<SQLValue>& parameters);
   int GetVersion();
   bool SetVersion(int newVersion);  
   sqlite3* m_db;
@@ -28,4 +69,25 @@ protected:
   
 private:
   bool EnsureVersionTable();
+  bool OpenHandle(SQLHandle& handle);
+  void CloseHandle(SQLHandle& handle);
+  SQLHandle* AcquireReader();
+  void ReleaseReader(SQLHandle* reader);
+  bool Run(SQLHandle& handle, const std::string& query,
+      const std::vector<SQLValue>& parameters, ProcessRowCallback& callback);
+  sqlite3_stmt* GetStatement(SQLHandle& handle, const std::string& query);
+  void WriterThread();
+  void FlushWrites();
+  std::string m_file;
+  SQLHandle m_writer;
+  std::recursive_mutex m_writerMutex;
+  std::vector<SQLHandle*> m_readers;
+  std::vector<SQLHandle*> m_idleReaders;
+  std::mutex m_readersMutex;
+  std::condition_variable m_readersCondition;
+  std::vector<SQLWrite> m_pendingWrites;
+  std::mutex m_writesMutex;
+  std::condition_variable m_writesCondition;
+  bool m_running = false;
+  std::thread m_writerThread;
 };
@@ -0,0 +1,117 @@
+#include "xxhash.h"
+#include <cstring>
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t RotateLeft(uint64_t x, int n)
+{
+  return (x << n) | (x >> (64 - n));
+}
+
+static inline uint64_t Read64(const unsigned char* p)
+{
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--)
+  {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+static inline uint64_t Read32(const unsigned char* p)
+{
+  return static_cast<uint64_t>(p[0]) | (static_cast<uint64_t>(p[1]) << 8)
+      | (static_cast<uint64_t>(p[2]) << 16) | (static_cast<uint64_t>(p[3]) << 24);
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+  acc += input * PRIME2;
+  acc = RotateLeft(acc, 31);
+  return acc * PRIME1;
+}
+
+static inline uint64_t MergeRound(uint64_t acc, uint64_t val)
+{
+  acc ^= Round(0, val);
+  return acc * PRIME1 + PRIME4;
+}
+
+uint64_t XXHash64(const void* input, size_t length, uint64_t seed)
+{
+  const unsigned char* p = static_cast<const unsigned char*>(input);
+  const unsigned char* end = p + length;
+  uint64_t hash;
+
+  if (length >= 32)
+  {
+    const unsigned char* limit = end - 32;
+    uint64_t v1 = seed + PRIME1 + PRIME2;
+    uint64_t v2 = seed + PRIME2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME1;
+    do
+    {
+      v1 = Round(v1, Read64(p));
+      v2 = Round(v2, Read64(p + 8));
+      v3 = Round(v3, Read64(p + 16));
+      v4 = Round(v4, Read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+    hash = MergeRound(hash, v1);
+    hash = MergeRound(hash, v2);
+    hash = MergeRound(hash, v3);
+    hash = MergeRound(hash, v4);
+  }
+  else
+  {
+    hash = seed + PRIME5;
+  }
+
+  hash += static_cast<uint64_t>(length);
+
+  while (p + 8 <= end)
+  {
+    hash ^= Round(0, Read64(p));
+    hash = RotateLeft(hash, 27) * PRIME1 + PRIME4;
+    p += 8;
+  }
+  if (p + 4 <= end)
+  {
+    hash ^= Read32(p) * PRIME1;
+    hash = RotateLeft(hash, 23) * PRIME2 + PRIME3;
+    p += 4;
+  }
+  while (p < end)
+  {
+    hash ^= (*p) * PRIME5;
+    hash = RotateLeft(hash, 11) * PRIME1;
+    p++;
+  }
+
+  hash ^= hash >> 33;
+  hash *= PRIME2;
+  hash ^= hash >> 29;
+  hash *= PRIME3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+std::string xxhash64(const std::string& str)
+{
+  static const char hexDigits[] = "0123456789abcdef";
+  uint64_t hash = XXHash64(str.data(), str.size());
+  std::string result(16, '0');
+  for (int i = 15; i >= 0; i--)
+  {
+    result[i] = hexDigits[hash & 0x0f];
+    hash >>= 4;
+  }
+  return result;
+}
@@ -0,0 +1,17 @@
+/*
+ * Implementation of the xxHash64 algorithm by Yann Collet.
+ * https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+ *
+ * A fast non-cryptographic hash, used to name cache entries.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+uint64_t XXHash64(const void* input, size_t length, uint64_t seed = 0);
+
+// hex digest of the 64 bit hash
+std::string xxhash64(const std::string& str);
@@ -0,0 +1,422 @@
+/*
+ * Micro benchmarks of the paths which turn api responses into what the add-on
+ * passes to Kodi, reported as ns and heap allocations per item. The payloads
+ * (500 broadcasts, 1000 recordings) are generated in the shape of the api
+ * responses, genres and channels are read from the fixtures of the mock server.
+ */
+
+#include "KodiShim.h"
+#include "TeleBoy.h"
+#include "Utils.h"
+#include "md5.h"
+#include "xxhash.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__GLIBC__)
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+#endif
+
+using namespace std::chrono;
+
+namespace
+{
+
+const int BROADCAST_COUNT = 500;
+const int RECORDING_COUNT = 1000;
+// the epg of one channel is loaded in pages of this size
+const int BROADCASTS_PER_CHANNEL = 100;
+
+std::atomic<uint64_t> allocations = {0};
+
+struct Options
+{
+  KodiShim::Config config;
+  std::string fixtures;
+  int iterations = 50;
+};
+
+struct Measurement
+{
+  double nanosPerItem;
+  double allocationsPerItem;
+};
+
+void PrintUsage(const char* name)
+{
+  fprintf(stderr, "Usage: %s [--iterations N] [--profile DIR] [--addon DIR] [--fixtures DIR]\n",
+      name);
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options)
+{
+  options.config.profilePath = "benchmark-profile";
+  options.config.addonPath = TELEBOY_ADDON_DIR;
+  options.config.logLevel = ADDON_LOG_WARNING;
+  options.fixtures = TELEBOY_FIXTURES_DIR;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    std::string arg = argv[i];
+    std::string value = argv[i + 1];
+    if (arg == "--iterations")
+    {
+      options.iterations = std::max(1, std::atoi(value.c_str()));
+    }
+    else if (arg == "--profile")
+    {
+      options.config.profilePath = value;
+    }
+    else if (arg == "--addon")
+    {
+      options.config.addonPath = value;
+    }
+    else if (arg == "--fixtures")
+    {
+      options.fixtures = value;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return argc % 2 == 1;
+}
+
+std::string ReadFixture(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+// Broadcasts of consecutive days, several channels and a mix of series,
+// movies and unknown genres, as /users/{id}/broadcasts returns them.
+std::string GenerateBroadcasts(int count)
+{
+  static const char* const titles[] = { "Tagesschau", "Tatort", "Die Simpsons",
+      "Super League", "Terra X", "Kassensturz", "Der Bergdoktor", "Glanz & Gloria" };
+  static const int genres[] = { 101, 102, 201, 202, 301, 401, 502, 601, 7, 999 };
+  std::string json = "{\"success\":true,\"status\":200,\"data\":{\"total\":"
+      + std::to_string(count) + ",\"items\":[";
+  char item[1024];
+  for (int i = 0; i < count; i++)
+  {
+    int minutes = i * 45;
+    int day = 4 + minutes / (24 * 60);
+    int begin = minutes % (24 * 60);
+    int end = begin + 45;
+    const char* title = titles[i % 8];
+    snprintf(item, sizeof(item), "%s{\"id\":%i,\"station_id\":%i,\"title\":\"%s\","
+        "\"begin\":\"2024-03-%02iT%02i:%02i:00+01:00\","
+        "\"end\":\"2024-03-%02iT%02i:%02i:00+01:00\","
+        "\"headline\":\"%s - Folge %i\",\"short_description\":\"Sendung %s vom Schweizer "
+        "Fernsehen mit einer Beschreibung von typischer L\\u00e4nge.\",\"subtitle\":\"%s\","
+        "\"genre_id\":%i,\"year\":%i,\"flags\":{\"is_recordable\":true}%s}",
+        i == 0 ? "" : ",", 120000000 + i, 1 + i / BROADCASTS_PER_CHANNEL, title,
+        day, begin / 60, begin % 60, day + end / (24 * 60), (end / 60) % 24, end % 60,
+        title, i, title, i % 3 == 0 ? "" : "Eine Episode", genres[i % 10], 1990 + i % 35,
+        i % 4 == 2 ? ",\"serie_season\":3,\"serie_episode\":12,\"original_title\":\"Episode\"" : "");
+    json += item;
+  }
+  return json + "]}}";
+}
+
+// Recordings as /users/{id}/recordings/ready returns them, the planned ones
+// have the same shape.
+std::string GenerateRecordings(int count)
+{
+  static const char* const titles[] = { "Tagesschau", "Tatort", "Die Simpsons",
+      "Super League", "Terra X", "Kassensturz", "Der Bergdoktor", "Glanz & Gloria" };
+  static const int genres[] = { 101, 201, 202, 301, 401, 502, 999 };
+  std::string json = "{\"success\":true,\"status\":200,\"data\":{\"total\":"
+      + std::to_string(count) + ",\"items\":[";
+  char item[1024];
+  for (int i = 0; i < count; i++)
+  {
+    const char* title = titles[i % 8];
+    snprintf(item, sizeof(item), "%s{\"id\":%i,\"station_id\":%i,\"title\":\"%s\","
+        "\"subtitle\":\"%s\",\"description\":\"Aufnahme von %s, mit einer ausf\\u00fchrlichen "
+        "Beschreibung der Sendung und der Mitwirkenden.\",\"short_description\":\"%s\","
+        "\"begin\":\"2024-%02i-%02iT20:05:00+01:00\",\"end\":\"2024-%02i-%02iT21:40:00+01:00\","
+        "\"genre_id\":%i,\"flags\":{\"is_recordable\":true}%s}",
+        i == 0 ? "" : ",", 81000000 + i, 1 + i % 30, title, i % 3 == 0 ? "" : "Folge 12",
+        title, title, 1 + i % 12, 1 + i % 28, 1 + i % 12, 1 + i % 28, genres[i % 7],
+        i % 4 == 2 ? ",\"serie_season\":30,\"serie_episode\":12" : "");
+    json += item;
+  }
+  return json + "]}}";
+}
+
+// Runs one warm-up pass and the given number of passes over items, setup
+// runs before each pass and is not measured. Reports the fastest pass.
+Measurement Measure(int items, int iterations, const std::function<void()>& setup,
+    const std::function<void()>& pass)
+{
+  setup();
+  pass();
+  Measurement best = { 0, 0 };
+  for (int i = 0; i < iterations; i++)
+  {
+    setup();
+    uint64_t allocationsBefore = allocations.load(std::memory_order_relaxed);
+    steady_clock::time_point start = steady_clock::now();
+    pass();
+    double nanos = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    uint64_t passAllocations = allocations.load(std::memory_order_relaxed) - allocationsBefore;
+    if (i == 0 || nanos / items < best.nanosPerItem)
+    {
+      best.nanosPerItem = nanos / items;
+    }
+    best.allocationsPerItem = static_cast<double>(passAllocations) / items;
+  }
+  return best;
+}
+
+void Print(const char* name, int items, const Measurement& measurement)
+{
+  printf("%-36s %6i %12.1f %12.2f\n", name, items, measurement.nanosPerItem,
+      measurement.allocationsPerItem);
+}
+
+// keeps the compiler from dropping results
+volatile size_t sink;
+
+class TeleBoyBenchmark : public TeleBoy
+{
+public:
+  TeleBoyBenchmark(const std::string& fixtures) : m_fixtures(fixtures)
+  {
+  }
+
+  // loads genres and channels like SessionInitialized does
+  bool LoadFixtures()
+  {
+    LoadGenres();
+    return LoadChannels() && !genresById.empty();
+  }
+
+  void Run(int iterations)
+  {
+    std::string broadcastsJson = GenerateBroadcasts(BROADCAST_COUNT);
+    std::string recordingsJson = GenerateRecordings(RECORDING_COUNT);
+    Document broadcasts;
+    Document recordings;
+    ApiGetResult(broadcastsJson, broadcasts);
+    ApiGetResult(recordingsJson, recordings);
+    const Value& broadcastItems = broadcasts["data"]["items"];
+    const Value& recordingItems = recordings["data"]["items"];
+
+    printf("%-36s %6s %12s %12s\n", "benchmark", "items", "ns/item", "allocs/item");
+
+    Print("ApiGetResult broadcasts", BROADCAST_COUNT, Measure(BROADCAST_COUNT, iterations,
+        [] {}, [&] {
+          Document doc;
+          ApiGetResult(broadcastsJson, doc);
+          sink = doc["data"]["items"].Size();
+        }));
+    Print("ApiGetResult recordings", RECORDING_COUNT, Measure(RECORDING_COUNT, iterations,
+        [] {}, [&] {
+          Document doc;
+          ApiGetResult(recordingsJson, doc);
+          sink = doc["data"]["items"].Size();
+        }));
+
+    // includes the copy of each tag the shim keeps, like Kodi keeps its own
+    Print("TransferEpgTag new", BROADCAST_COUNT, Measure(BROADCAST_COUNT, iterations,
+        [&] {
+          KodiShim::Recorder::TakeEpgEvents();
+          std::lock_guard<std::mutex> lock(sendEpgToKodiMutex);
+          sentEpgTags.clear();
+        }, [&] {
+          std::lock_guard<std::mutex> lock(sendEpgToKodiMutex);
+          for (Value::ConstValueIterator item = broadcastItems.Begin(); item != broadcastItems.End();
+              ++item)
+          {
+            TransferEpgTag(*item, (*item)["station_id"].GetInt());
+          }
+        }));
+    // broadcasts kodi already has, e.g. from the update of an epg slice
+    Print("TransferEpgTag unchanged", BROADCAST_COUNT, Measure(BROADCAST_COUNT, iterations,
+        [] { KodiShim::Recorder::TakeEpgEvents(); }, [&] {
+          std::lock_guard<std::mutex> lock(sendEpgToKodiMutex);
+          for (Value::ConstValueIterator item = broadcastItems.Begin(); item != broadcastItems.End();
+              ++item)
+          {
+            TransferEpgTag(*item, (*item)["station_id"].GetInt());
+          }
+        }));
+    KodiShim::Recorder::TakeEpgEvents();
+
+    kodi::addon::PVRRecordingsResultSet recordingResults;
+    Print("TransferRecording", RECORDING_COUNT, Measure(RECORDING_COUNT, iterations,
+        [&] { recordingResults = kodi::addon::PVRRecordingsResultSet(); }, [&] {
+          for (Value::ConstValueIterator item = recordingItems.Begin(); item != recordingItems.End();
+              ++item)
+          {
+            TransferRecording(*item, recordingResults);
+          }
+        }));
+    kodi::addon::PVRTimersResultSet timerResults;
+    Print("TransferTimer", RECORDING_COUNT, Measure(RECORDING_COUNT, iterations,
+        [&] { timerResults = kodi::addon::PVRTimersResultSet(); }, [&] {
+          for (Value::ConstValueIterator item = recordingItems.Begin(); item != recordingItems.End();
+              ++item)
+          {
+            TransferTimer(*item, timerResults);
+          }
+        }));
+
+    std::vector<std::string> times;
+    std::vector<std::string> titles;
+    std::vector<std::string> genreNames;
+    for (Value::ConstValueIterator item = broadcastItems.Begin(); item != broadcastItems.End();
+        ++item)
+    {
+      times.push_back(GetStringOrEmpty(*item, "begin"));
+      titles.push_back(GetStringOrEmpty(*item, "headline"));
+      genreNames.push_back(GetGenre((*item)["genre_id"].GetInt()).nameEn);
+    }
+    Print("Utils::StringToTime", BROADCAST_COUNT, Measure(BROADCAST_COUNT, iterations,
+        [] {}, [&] {
+          for (const std::string& time : times)
+          {
+            sink = Utils::StringToTime(time);
+          }
+        }));
+    Print("Utils::UrlEncode", BROADCAST_COUNT, Measure(BROADCAST_COUNT, iterations,
+        [] {}, [&] {
+          for (const std::string& title : titles)
+          {
+            sink = Utils::UrlEncode(title).size();
+          }
+        }));
+    Print("Categories::Category", BROADCAST_COUNT, Measure(BROADCAST_COUNT, iterations,
+        [] {}, [&] {
+          for (const std::string& name : genreNames)
+          {
+            sink = m_categories.Category(name);
+          }
+        }));
+
+    // the urls of one day of epg for every channel
+    std::vector<std::string> urls;
+    time_t sliceStart = 1709506800;
+    for (int i = 0; i < BROADCAST_COUNT; i++)
+    {
+      urls.push_back(TELEBOY_API_URL + GetBroadcastsUrl(1 + i % 50,
+          sliceStart + (i / 50) * 24 * 60 * 60, 0));
+    }
+    Print("md5 cache key", BROADCAST_COUNT, Measure(BROADCAST_COUNT, iterations,
+        [] {}, [&] {
+          for (const std::string& url : urls)
+          {
+            sink = md5(url).size();
+          }
+        }));
+    Print("xxhash64 cache key", BROADCAST_COUNT, Measure(BROADCAST_COUNT, iterations,
+        [] {}, [&] {
+          for (const std::string& url : urls)
+          {
+            sink = xxhash64(url).size();
+          }
+        }));
+  }
+
+protected:
+  // answers the requests of LoadGenres and LoadChannels from the fixtures
+  bool ApiGetWithoutConnectedCheck(string url, Document &doc, time_t timeout) override
+  {
+    std::string file;
+    if (url.rfind("/epg/genres", 0) == 0)
+    {
+      file = "epg_genres.json";
+    }
+    else if (url.rfind("/epg/stations", 0) == 0)
+    {
+      file = "epg_stations.json";
+    }
+    else if (url.find("/stations") != std::string::npos)
+    {
+      file = "user_stations.json";
+    }
+    else
+    {
+      return false;
+    }
+    return ApiGetResult(ReadFixture(m_fixtures + "/" + file), doc);
+  }
+
+private:
+  std::string m_fixtures;
+};
+
+} /* namespace */
+
+#if defined(__GLIBC__)
+// counts every heap allocation, also those of rapidjson which uses malloc
+extern "C" void* malloc(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(pointer, size);
+}
+#else
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* pointer = std::malloc(size == 0 ? 1 : size);
+  if (pointer == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+  std::free(pointer);
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+  Options options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+  if (!KodiShim::Init(options.config))
+  {
+    return 1;
+  }
+  TeleBoyBenchmark benchmark(options.fixtures);
+  if (!benchmark.LoadFixtures())
+  {
+    fprintf(stderr, "Could not load the fixtures from %s\n", options.fixtures.c_str());
+    return 1;
+  }
+  benchmark.Run(options.iterations);
+  return 0;
+}
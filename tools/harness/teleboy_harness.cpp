@@ -0,0 +1,320 @@
+/*
+ * Measures the add-on against the Teleboy mock in tools/mock-server: time to
+ * connect, time until the epg of the requested channels arrived in Kodi after
+ * it was requested (epg refill) and the time to get a stream when zapping
+ * through the channels. Exits with 1 if a budget is exceeded or a step fails.
+ */
+
+#include "KodiShim.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace
+{
+
+const milliseconds EPG_QUIET_PERIOD(2000);
+const milliseconds EPG_POLL_INTERVAL(50);
+// broadcasts this close to now may come from the now/next update after login
+const time_t NOW_NEXT_RANGE = 6 * 60 * 60;
+
+struct Options
+{
+  KodiShim::Config config;
+  int channels = 0;
+  int zaps = 10;
+  int zapDwell = 500;
+  int timeout = 120;
+  long long maxEpgRefill = 0;
+  long long maxZap = 0;
+  std::string report;
+};
+
+struct Result
+{
+  long long connect = -1;
+  int channels = 0;
+  long long epgRefill = -1;
+  size_t epgEvents = 0;
+  int epgChannels = 0;
+  int epgChannelsMissing = 0;
+  std::vector<long long> zaps;
+  int zapFailures = 0;
+};
+
+void PrintUsage(const char* name)
+{
+  fprintf(stderr, "Usage: %s --settings FILE [--profile DIR] [--addon DIR] [--channels N]\n"
+      "    [--past-days N] [--future-days N] [--zaps N] [--zap-dwell MS] [--timeout SECONDS]\n"
+      "    [--max-epg-refill MS] [--max-zap MS] [--report FILE] [--debug]\n", name);
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options)
+{
+  options.config.profilePath = "profile";
+  options.config.addonPath = TELEBOY_ADDON_DIR;
+  options.config.logLevel = ADDON_LOG_WARNING;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "--debug")
+    {
+      options.config.logLevel = ADDON_LOG_DEBUG;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--settings")
+    {
+      options.config.settingsFile = value;
+    }
+    else if (arg == "--profile")
+    {
+      options.config.profilePath = value;
+    }
+    else if (arg == "--addon")
+    {
+      options.config.addonPath = value;
+    }
+    else if (arg == "--channels")
+    {
+      options.channels = std::atoi(value.c_str());
+    }
+    else if (arg == "--past-days")
+    {
+      options.config.epgMaxPastDays = std::atoi(value.c_str());
+    }
+    else if (arg == "--future-days")
+    {
+      options.config.epgMaxFutureDays = std::atoi(value.c_str());
+    }
+    else if (arg == "--zaps")
+    {
+      options.zaps = std::atoi(value.c_str());
+    }
+    else if (arg == "--zap-dwell")
+    {
+      options.zapDwell = std::atoi(value.c_str());
+    }
+    else if (arg == "--timeout")
+    {
+      options.timeout = std::atoi(value.c_str());
+    }
+    else if (arg == "--max-epg-refill")
+    {
+      options.maxEpgRefill = std::atoll(value.c_str());
+    }
+    else if (arg == "--max-zap")
+    {
+      options.maxZap = std::atoll(value.c_str());
+    }
+    else if (arg == "--report")
+    {
+      options.report = value;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return !options.config.settingsFile.empty();
+}
+
+long long MillisBetween(steady_clock::time_point start, steady_clock::time_point end)
+{
+  return duration_cast<milliseconds>(end - start).count();
+}
+
+long long Percentile(std::vector<long long> values, int percent)
+{
+  if (values.empty())
+  {
+    return -1;
+  }
+  std::sort(values.begin(), values.end());
+  size_t index = (values.size() * percent + 99) / 100;
+  return values[std::min(values.size(), std::max<size_t>(index, 1)) - 1];
+}
+
+// Requests the epg window Kodi asks for on start-up for the given channels and
+// waits until each of them got broadcasts outside of the now/next range and
+// no more arrived for a while.
+void MeasureEpgRefill(kodi::addon::CInstancePVRClient* client,
+    const std::vector<kodi::addon::PVRChannel>& channels, const Options& options,
+    Result& result)
+{
+  KodiShim::Recorder::TakeEpgEvents();
+  steady_clock::time_point start = steady_clock::now();
+  steady_clock::time_point deadline = start + seconds(options.timeout);
+  time_t now = time(nullptr);
+  std::set<int> pending;
+  for (const kodi::addon::PVRChannel& channel : channels)
+  {
+    int channelUid = static_cast<int>(channel.GetUniqueId());
+    pending.insert(channelUid);
+    kodi::addon::PVREPGTagsResultSet tags;
+    client->GetEPGForChannel(channelUid, now - client->EpgMaxPastDays() * 24 * 60 * 60,
+        now + client->EpgMaxFutureDays() * 24 * 60 * 60, tags);
+  }
+
+  steady_clock::time_point lastEvent = start;
+  while (steady_clock::now() < deadline)
+  {
+    for (const KodiShim::EpgEvent& event : KodiShim::Recorder::TakeEpgEvents())
+    {
+      int channelUid = static_cast<int>(event.tag.GetUniqueChannelId());
+      if (channels.end() == std::find_if(channels.begin(), channels.end(),
+          [channelUid](const kodi::addon::PVRChannel& channel) {
+            return static_cast<int>(channel.GetUniqueId()) == channelUid; }))
+      {
+        continue;
+      }
+      time_t startTime = event.tag.GetStartTime();
+      if (startTime < now - NOW_NEXT_RANGE || startTime > now + NOW_NEXT_RANGE)
+      {
+        pending.erase(channelUid);
+      }
+      lastEvent = std::max(lastEvent, event.time);
+      result.epgEvents++;
+    }
+    if (pending.empty() && steady_clock::now() - lastEvent >= EPG_QUIET_PERIOD)
+    {
+      break;
+    }
+    std::this_thread::sleep_for(EPG_POLL_INTERVAL);
+  }
+  result.epgChannels = static_cast<int>(channels.size());
+  result.epgChannelsMissing = static_cast<int>(pending.size());
+  result.epgRefill = MillisBetween(start, lastEvent);
+}
+
+// Switches through the channels like a user zapping up, leaving time for
+// the prefetch of the neighbours between the switches.
+void MeasureZaps(kodi::addon::CInstancePVRClient* client,
+    const std::vector<kodi::addon::PVRChannel>& channels, const Options& options,
+    Result& result)
+{
+  for (int i = 0; i < options.zaps && !channels.empty(); i++)
+  {
+    const kodi::addon::PVRChannel& channel = channels[i % channels.size()];
+    std::vector<kodi::addon::PVRStreamProperty> properties;
+    steady_clock::time_point start = steady_clock::now();
+    PVR_ERROR error = client->GetChannelStreamProperties(channel, properties);
+    long long millis = MillisBetween(start, steady_clock::now());
+    if (error != PVR_ERROR_NO_ERROR || properties.empty())
+    {
+      fprintf(stderr, "Zap to channel %u failed\n", channel.GetUniqueId());
+      result.zapFailures++;
+    }
+    else
+    {
+      result.zaps.push_back(millis);
+    }
+    std::this_thread::sleep_for(milliseconds(options.zapDwell));
+  }
+}
+
+void WriteReport(const std::string& path, const Result& result)
+{
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr)
+  {
+    fprintf(stderr, "Could not write report %s\n", path.c_str());
+    return;
+  }
+  fprintf(file, "{\n  \"connect_ms\": %lld,\n  \"channels\": %i,\n", result.connect,
+      result.channels);
+  fprintf(file, "  \"epg_refill_ms\": %lld,\n  \"epg_events\": %zu,\n", result.epgRefill,
+      result.epgEvents);
+  fprintf(file, "  \"epg_channels\": %i,\n  \"epg_channels_missing\": %i,\n",
+      result.epgChannels, result.epgChannelsMissing);
+  fprintf(file, "  \"zaps\": %zu,\n  \"zap_failures\": %i,\n", result.zaps.size(),
+      result.zapFailures);
+  fprintf(file, "  \"zap_first_ms\": %lld,\n  \"zap_median_ms\": %lld,\n",
+      result.zaps.empty() ? -1 : result.zaps.front(), Percentile(result.zaps, 50));
+  fprintf(file, "  \"zap_p95_ms\": %lld,\n  \"zap_max_ms\": %lld\n}\n",
+      Percentile(result.zaps, 95), Percentile(result.zaps, 100));
+  fclose(file);
+}
+
+} /* namespace */
+
+int main(int argc, char* argv[])
+{
+  Options options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+  if (!KodiShim::Init(options.config))
+  {
+    return 1;
+  }
+
+  Result result;
+  steady_clock::time_point start = steady_clock::now();
+  kodi::addon::CInstancePVRClient* client = KodiShim::CreateAddon();
+  if (client == nullptr)
+  {
+    fprintf(stderr, "The add-on could not be created\n");
+    return 1;
+  }
+  bool failed = true;
+  if (KodiShim::Recorder::WaitForConnectionState(PVR_CONNECTION_STATE_CONNECTED,
+      seconds(options.timeout)))
+  {
+    result.connect = MillisBetween(start, steady_clock::now());
+    kodi::addon::PVRChannelsResultSet channelSet;
+    client->GetChannels(false, channelSet);
+    std::vector<kodi::addon::PVRChannel> channels = channelSet.Items();
+    result.channels = static_cast<int>(channels.size());
+    if (options.channels > 0 && channels.size() > static_cast<size_t>(options.channels))
+    {
+      channels.resize(options.channels);
+    }
+    MeasureEpgRefill(client, channels, options, result);
+    MeasureZaps(client, channels, options, result);
+    failed = channels.empty() || result.epgChannelsMissing > 0 || result.zapFailures > 0;
+  }
+  else
+  {
+    fprintf(stderr, "Not connected after %i seconds\n", options.timeout);
+  }
+  KodiShim::DestroyAddon(client);
+
+  printf("connect            %lld ms\n", result.connect);
+  printf("channels           %i\n", result.channels);
+  printf("epg refill         %lld ms, %zu events, %i of %i channels\n", result.epgRefill,
+      result.epgEvents, result.epgChannels - result.epgChannelsMissing, result.epgChannels);
+  printf("zap                first %lld ms, median %lld ms, p95 %lld ms, %i failed\n",
+      result.zaps.empty() ? -1 : result.zaps.front(), Percentile(result.zaps, 50),
+      Percentile(result.zaps, 95), result.zapFailures);
+  if (!options.report.empty())
+  {
+    WriteReport(options.report, result);
+  }
+
+  if (options.maxEpgRefill > 0 && result.epgRefill > options.maxEpgRefill)
+  {
+    fprintf(stderr, "epg refill took %lld ms, budget %lld ms\n", result.epgRefill,
+        options.maxEpgRefill);
+    failed = true;
+  }
+  if (options.maxZap > 0 && Percentile(result.zaps, 95) > options.maxZap)
+  {
+    fprintf(stderr, "p95 zap took %lld ms, budget %lld ms\n", Percentile(result.zaps, 95),
+        options.maxZap);
+    failed = true;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Runs the add-on outside of Kodi against the Kodi API shim: logs in, lists
+ * the channels, loads the epg of the first channels and lists recordings and
+ * timers, printing what the add-on passed to Kodi along the way.
+ */
+
+#include "KodiShim.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace
+{
+
+const milliseconds EPG_QUIET_PERIOD(2000);
+
+struct Options
+{
+  KodiShim::Config config;
+  int channels = 5;
+  int timeout = 60;
+};
+
+void PrintUsage(const char* name)
+{
+  fprintf(stderr, "Usage: %s --settings FILE [--profile DIR] [--addon DIR] "
+      "[--channels N] [--timeout SECONDS] [--debug]\n", name);
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options)
+{
+  options.config.profilePath = "profile";
+  options.config.addonPath = TELEBOY_ADDON_DIR;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "--debug")
+    {
+      options.config.logLevel = ADDON_LOG_DEBUG;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--settings")
+    {
+      options.config.settingsFile = value;
+    }
+    else if (arg == "--profile")
+    {
+      options.config.profilePath = value;
+    }
+    else if (arg == "--addon")
+    {
+      options.config.addonPath = value;
+    }
+    else if (arg == "--channels")
+    {
+      options.channels = std::atoi(value.c_str());
+    }
+    else if (arg == "--timeout")
+    {
+      options.timeout = std::atoi(value.c_str());
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return !options.config.settingsFile.empty();
+}
+
+long long MillisSince(steady_clock::time_point start)
+{
+  return duration_cast<milliseconds>(steady_clock::now() - start).count();
+}
+
+} /* namespace */
+
+int main(int argc, char* argv[])
+{
+  Options options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+  if (!KodiShim::Init(options.config))
+  {
+    return 1;
+  }
+
+  steady_clock::time_point start = steady_clock::now();
+  kodi::addon::CInstancePVRClient* client = KodiShim::CreateAddon();
+  if (client == nullptr)
+  {
+    fprintf(stderr, "The add-on could not be created\n");
+    return 1;
+  }
+  int result = 1;
+  if (!KodiShim::Recorder::WaitForConnectionState(PVR_CONNECTION_STATE_CONNECTED,
+      seconds(options.timeout)))
+  {
+    fprintf(stderr, "Not connected after %i seconds\n", options.timeout);
+  }
+  else
+  {
+    printf("connected after %lld ms\n", MillisSince(start));
+
+    start = steady_clock::now();
+    kodi::addon::PVRChannelsResultSet channels;
+    client->GetChannels(false, channels);
+    printf("%zu channels in %lld ms\n", channels.Items().size(), MillisSince(start));
+
+    // the add-on loads the epg asynchronously and passes it as epg events
+    KodiShim::Recorder::WaitForEpgQuiet(EPG_QUIET_PERIOD, seconds(options.timeout));
+    KodiShim::Recorder::TakeEpgEvents();
+    start = steady_clock::now();
+    time_t now = time(nullptr);
+    int requested = 0;
+    for (const kodi::addon::PVRChannel& channel : channels.Items())
+    {
+      if (requested == options.channels)
+      {
+        break;
+      }
+      requested++;
+      kodi::addon::PVREPGTagsResultSet tags;
+      client->GetEPGForChannel(static_cast<int>(channel.GetUniqueId()),
+          now - client->EpgMaxPastDays() * 24 * 60 * 60,
+          now + client->EpgMaxFutureDays() * 24 * 60 * 60, tags);
+    }
+    KodiShim::Recorder::WaitForEpgQuiet(EPG_QUIET_PERIOD, seconds(options.timeout));
+    std::vector<KodiShim::EpgEvent> events = KodiShim::Recorder::TakeEpgEvents();
+    long long epgMillis = events.empty() ? 0
+        : duration_cast<milliseconds>(events.back().time - start).count();
+    printf("%zu epg events for %i channels in %lld ms\n", events.size(),
+        requested, epgMillis);
+
+    start = steady_clock::now();
+    kodi::addon::PVRRecordingsResultSet recordings;
+    client->GetRecordings(false, recordings);
+    printf("%zu recordings in %lld ms\n", recordings.Items().size(), MillisSince(start));
+
+    start = steady_clock::now();
+    kodi::addon::PVRTimersResultSet timers;
+    client->GetTimers(timers);
+    printf("%zu timers in %lld ms\n", timers.Items().size(), MillisSince(start));
+    result = 0;
+  }
+
+  for (const KodiShim::ConnectionEvent& event : KodiShim::Recorder::GetConnectionEvents())
+  {
+    printf("connection state %i: %s\n", event.state, event.message.c_str());
+  }
+  for (const KodiShim::Notification& notification : KodiShim::Recorder::GetNotifications())
+  {
+    printf("notification: %s\n", notification.message.c_str());
+  }
+  printf("%i timer updates, %i recording updates\n", KodiShim::Recorder::GetTimerUpdates(),
+      KodiShim::Recorder::GetRecordingUpdates());
+  KodiShim::DestroyAddon(client);
+  return result;
+}
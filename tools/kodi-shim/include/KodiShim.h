@@ -0,0 +1,83 @@
+/*
+ * Control side of the Kodi API shim, used by the tools which run the
+ * add-on outside of Kodi.
+ */
+
+#pragma once
+
+#include "kodi/AddonBase.h"
+#include "kodi/General.h"
+#include "kodi/addon-instance/PVR.h"
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// defined by ADDONCREATOR in the add-on
+kodi::addon::CAddonBase* KodiShimCreateAddon();
+
+namespace KodiShim
+{
+
+struct Config
+{
+  // local directory of special://profile, created if missing
+  std::string profilePath;
+  // local directory of the add-on, i.e. pvr.teleboy in the source tree
+  std::string addonPath;
+  // settings in lines of "id=value", see settings.xml for the ids
+  std::string settingsFile;
+  int epgMaxPastDays = 1;
+  int epgMaxFutureDays = 3;
+  AddonLog logLevel = ADDON_LOG_INFO;
+};
+
+// Must be called before the add-on is created.
+bool Init(const Config& config);
+
+// Creates the add-on, which is also its PVR client instance.
+kodi::addon::CInstancePVRClient* CreateAddon();
+void DestroyAddon(kodi::addon::CInstancePVRClient* client);
+
+struct EpgEvent
+{
+  kodi::addon::PVREPGTag tag;
+  EPG_EVENT_STATE state;
+  std::chrono::steady_clock::time_point time;
+};
+
+struct ConnectionEvent
+{
+  std::string connectionString;
+  PVR_CONNECTION_STATE state;
+  std::string message;
+  std::chrono::steady_clock::time_point time;
+};
+
+struct Notification
+{
+  QueueMsg type;
+  std::string message;
+};
+
+// Everything the add-on passes to Kodi on its own initiative.
+class Recorder
+{
+public:
+  static std::vector<EpgEvent> TakeEpgEvents();
+  static size_t GetEpgEventCount();
+  static std::vector<ConnectionEvent> GetConnectionEvents();
+  static std::vector<Notification> GetNotifications();
+  static int GetTimerUpdates();
+  static int GetRecordingUpdates();
+  // returns false if the state was not reached within the timeout
+  static bool WaitForConnectionState(PVR_CONNECTION_STATE state,
+      std::chrono::milliseconds timeout);
+  // waits until there are epg events not taken yet and no more arrived for
+  // quietPeriod, returns false on timeout
+  static bool WaitForEpgQuiet(std::chrono::milliseconds quietPeriod,
+      std::chrono::milliseconds timeout);
+  static void Clear();
+};
+
+} /* namespace KodiShim */
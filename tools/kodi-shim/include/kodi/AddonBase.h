@@ -0,0 +1,95 @@
+/*
+ * Link-time stand-in for the part of the Kodi add-on API used by
+ * pvr.teleboy. Only what the add-on calls is declared, the behaviour is
+ * implemented in tools/kodi-shim/src and can be inspected through KodiShim.h.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#define STR_HELPER(x) #x
+#define STR(x) STR_HELPER(x)
+
+#define ATTR_DLL_LOCAL
+
+typedef enum AddonLog
+{
+  ADDON_LOG_DEBUG = 0,
+  ADDON_LOG_INFO = 1,
+  ADDON_LOG_WARNING = 2,
+  ADDON_LOG_ERROR = 3,
+  ADDON_LOG_FATAL = 4
+} AddonLog;
+
+typedef enum ADDON_STATUS
+{
+  ADDON_STATUS_OK,
+  ADDON_STATUS_LOST_CONNECTION,
+  ADDON_STATUS_NEED_RESTART,
+  ADDON_STATUS_NEED_SETTINGS,
+  ADDON_STATUS_UNKNOWN,
+  ADDON_STATUS_PERMANENT_FAILURE,
+  ADDON_STATUS_NOT_IMPLEMENTED
+} ADDON_STATUS;
+
+namespace kodi
+{
+
+void Log(const AddonLog loglevel, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+namespace addon
+{
+
+class CSettingValue
+{
+public:
+  explicit CSettingValue(const std::string& settingValue) : m_value(settingValue) {}
+  bool empty() const { return m_value.empty(); }
+  std::string GetString() const { return m_value; }
+  int GetInt() const { return std::atoi(m_value.c_str()); }
+  unsigned int GetUInt() const { return static_cast<unsigned int>(std::atoi(m_value.c_str())); }
+  bool GetBoolean() const { return m_value == "true" || m_value == "1"; }
+  float GetFloat() const { return static_cast<float>(std::atof(m_value.c_str())); }
+private:
+  std::string m_value;
+};
+
+std::string GetSettingString(const std::string& settingName,
+    const std::string& defaultValue = "");
+bool GetSettingBoolean(const std::string& settingName, bool defaultValue = false);
+int GetSettingInt(const std::string& settingName, int defaultValue = 0);
+std::string GetLocalizedString(uint32_t labelId, const std::string& defaultStr = "");
+std::string GetAddonPath(const std::string& append = "");
+std::string GetUserPath(const std::string& append = "");
+
+class CAddonBase
+{
+public:
+  CAddonBase() = default;
+  virtual ~CAddonBase() = default;
+  virtual ADDON_STATUS Create() { return ADDON_STATUS_OK; }
+  virtual ADDON_STATUS SetSetting(const std::string& settingName,
+      const CSettingValue& settingValue)
+  {
+    return ADDON_STATUS_UNKNOWN;
+  }
+};
+
+} /* namespace addon */
+} /* namespace kodi */
+
+// Instead of the exported C interface of Kodi, the add-on is created through
+// KodiShim::CreateAddon().
+#define ADDONCREATOR(AddonClass) \
+  kodi::addon::CAddonBase* KodiShimCreateAddon() \
+  { \
+    return new AddonClass(); \
+  }
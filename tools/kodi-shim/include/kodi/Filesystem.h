@@ -0,0 +1,112 @@
+/*
+ * VFS of the shim: special:// paths are mapped to local directories, see
+ * KodiShim::Config, and CURL files are served by libcurl.
+ */
+
+#pragma once
+
+#include "AddonBase.h"
+#include <map>
+#include <ctime>
+#include <memory>
+#include <sys/types.h>
+
+typedef enum CURLOptiontype
+{
+  ADDON_CURL_OPTION_OPTION,
+  ADDON_CURL_OPTION_PROTOCOL,
+  ADDON_CURL_OPTION_CREDENTIALS,
+  ADDON_CURL_OPTION_HEADER
+} CURLOptiontype;
+
+typedef enum OpenFileFlags
+{
+  ADDON_READ_TRUNCATED = 0x01,
+  ADDON_READ_CHUNKED = 0x02,
+  ADDON_READ_CACHED = 0x04,
+  ADDON_READ_NO_CACHE = 0x08,
+  ADDON_READ_BITRATE = 0x10,
+  ADDON_READ_MULTI_STREAM = 0x20,
+  ADDON_READ_AUDIO_VIDEO = 0x40,
+  ADDON_READ_AFTER_WRITE = 0x80,
+  ADDON_READ_REOPEN = 0x100
+} OpenFileFlags;
+
+typedef enum FilePropertyTypes
+{
+  ADDON_FILE_PROPERTY_RESPONSE_PROTOCOL,
+  ADDON_FILE_PROPERTY_RESPONSE_HEADER,
+  ADDON_FILE_PROPERTY_CONTENT_TYPE,
+  ADDON_FILE_PROPERTY_CONTENT_CHARSET,
+  ADDON_FILE_PROPERTY_MIME_TYPE,
+  ADDON_FILE_PROPERTY_EFFECTIVE_URL
+} FilePropertyTypes;
+
+namespace kodi
+{
+namespace vfs
+{
+
+class CDirEntry
+{
+public:
+  CDirEntry(const std::string& label = "", const std::string& path = "",
+      bool folder = false, int64_t size = -1, time_t dateTime = 0)
+    : m_label(label), m_path(path), m_folder(folder), m_size(size), m_dateTime(dateTime)
+  {
+  }
+  const std::string& Label() const { return m_label; }
+  const std::string& Path() const { return m_path; }
+  bool IsFolder() const { return m_folder; }
+  int64_t Size() const { return m_size; }
+  const time_t& DateTime() const { return m_dateTime; }
+private:
+  std::string m_label;
+  std::string m_path;
+  bool m_folder;
+  int64_t m_size;
+  time_t m_dateTime;
+};
+
+bool FileExists(const std::string& filename, bool usecache = false);
+bool DirectoryExists(const std::string& path);
+bool CreateDirectory(const std::string& path);
+bool RemoveDirectory(const std::string& path, bool recursive = false);
+bool DeleteFile(const std::string& filename);
+bool RenameFile(const std::string& filename, const std::string& newFileName);
+bool GetDirectory(const std::string& path, const std::string& mask,
+    std::vector<CDirEntry>& items);
+std::string TranslateSpecialProtocol(const std::string& source);
+
+class CFileImpl;
+
+class CFile
+{
+public:
+  CFile();
+  ~CFile();
+  CFile(const CFile&) = delete;
+  CFile& operator=(const CFile&) = delete;
+
+  bool OpenFile(const std::string& filename, unsigned int flags = 0);
+  bool OpenFileForWrite(const std::string& filename, bool overwrite = false);
+  void Close();
+
+  bool CURLCreate(const std::string& url);
+  bool CURLAddOption(CURLOptiontype type, const std::string& name, const std::string& value);
+  bool CURLOpen(unsigned int flags = 0);
+
+  ssize_t Read(void* ptr, size_t size);
+  bool ReadLine(std::string& line);
+  ssize_t Write(const void* ptr, size_t size);
+  int64_t GetLength() const;
+
+  std::string GetPropertyValue(FilePropertyTypes type, const std::string& name) const;
+  std::vector<std::string> GetPropertyValues(FilePropertyTypes type,
+      const std::string& name) const;
+private:
+  std::unique_ptr<CFileImpl> m_impl;
+};
+
+} /* namespace vfs */
+} /* namespace kodi */
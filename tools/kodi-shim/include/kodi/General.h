@@ -0,0 +1,20 @@
+#pragma once
+
+#include "AddonBase.h"
+
+typedef enum QueueMsg
+{
+  QUEUE_INFO,
+  QUEUE_WARNING,
+  QUEUE_ERROR,
+  QUEUE_OWN_STYLE
+} QueueMsg;
+
+namespace kodi
+{
+
+// recorded, see KodiShim::Recorder
+void QueueNotification(QueueMsg type, const std::string& header,
+    const std::string& message);
+
+} /* namespace kodi */
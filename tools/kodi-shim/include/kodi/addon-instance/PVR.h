@@ -0,0 +1,317 @@
+/*
+ * PVR client instance of the shim. The data types keep their values, so
+ * that recorded callbacks and result sets can be inspected, and the
+ * callbacks into Kodi are recorded by KodiShim::Recorder.
+ */
+
+#pragma once
+
+#include "../AddonBase.h"
+#include <vector>
+
+typedef enum PVR_ERROR
+{
+  PVR_ERROR_NO_ERROR = 0,
+  PVR_ERROR_UNKNOWN = -1,
+  PVR_ERROR_NOT_IMPLEMENTED = -2,
+  PVR_ERROR_SERVER_ERROR = -3,
+  PVR_ERROR_SERVER_TIMEOUT = -4,
+  PVR_ERROR_REJECTED = -5,
+  PVR_ERROR_ALREADY_PRESENT = -6,
+  PVR_ERROR_INVALID_PARAMETERS = -7,
+  PVR_ERROR_RECORDING_RUNNING = -8,
+  PVR_ERROR_FAILED = -9
+} PVR_ERROR;
+
+typedef enum PVR_CONNECTION_STATE
+{
+  PVR_CONNECTION_STATE_UNKNOWN = 0,
+  PVR_CONNECTION_STATE_SERVER_UNREACHABLE = 1,
+  PVR_CONNECTION_STATE_SERVER_MISMATCH = 2,
+  PVR_CONNECTION_STATE_VERSION_MISMATCH = 3,
+  PVR_CONNECTION_STATE_ACCESS_DENIED = 4,
+  PVR_CONNECTION_STATE_CONNECTED = 5,
+  PVR_CONNECTION_STATE_DISCONNECTED = 6,
+  PVR_CONNECTION_STATE_CONNECTING = 7
+} PVR_CONNECTION_STATE;
+
+typedef enum EPG_EVENT_STATE
+{
+  EPG_EVENT_CREATED = 0,
+  EPG_EVENT_DELETED = 1,
+  EPG_EVENT_UPDATED = 2
+} EPG_EVENT_STATE;
+
+typedef enum PVR_EDL_TYPE
+{
+  PVR_EDL_TYPE_CUT = 0,
+  PVR_EDL_TYPE_MUTE = 1,
+  PVR_EDL_TYPE_SCENE = 2,
+  PVR_EDL_TYPE_COMBREAK = 3
+} PVR_EDL_TYPE;
+
+typedef enum PVR_TIMER_STATE
+{
+  PVR_TIMER_STATE_NEW = 0,
+  PVR_TIMER_STATE_SCHEDULED = 1,
+  PVR_TIMER_STATE_RECORDING = 2,
+  PVR_TIMER_STATE_COMPLETED = 3
+} PVR_TIMER_STATE;
+
+static const int EPG_GENRE_USE_STRING = 0x100;
+static const int EPG_TAG_INVALID_SERIES_EPISODE = -1;
+static const unsigned int EPG_TAG_FLAG_UNDEFINED = 0;
+static const unsigned int EPG_TAG_INVALID_UID = 0;
+static const unsigned int PVR_TIMER_TYPE_ATTRIBUTE_NONE = 0;
+static const unsigned int PVR_TIMER_TYPE_IS_MANUAL = 1 << 0;
+
+#define PVR_STREAM_PROPERTY_STREAMURL "streamurl"
+#define PVR_STREAM_PROPERTY_INPUTSTREAM "inputstream"
+#define PVR_STREAM_PROPERTY_MIMETYPE "mimetype"
+#define PVR_STREAM_PROPERTY_ISREALTIMESTREAM "isrealtimestream"
+
+// a value with a setter and a getter, the way the Kodi types expose them
+#define KODI_SHIM_PROPERTY(Type, Name) \
+public: \
+  void Set##Name(const Type& value) { m_##Name = value; } \
+  Type Get##Name() const { return m_##Name; } \
+private: \
+  Type m_##Name{};
+
+namespace kodi
+{
+namespace addon
+{
+
+class PVRCapabilities
+{
+  KODI_SHIM_PROPERTY(bool, SupportsEPG)
+  KODI_SHIM_PROPERTY(bool, SupportsEPGEdl)
+  KODI_SHIM_PROPERTY(bool, SupportsTV)
+  KODI_SHIM_PROPERTY(bool, SupportsRadio)
+  KODI_SHIM_PROPERTY(bool, SupportsRecordings)
+  KODI_SHIM_PROPERTY(bool, SupportsRecordingsDelete)
+  KODI_SHIM_PROPERTY(bool, SupportsTimers)
+  KODI_SHIM_PROPERTY(bool, SupportsChannelGroups)
+  KODI_SHIM_PROPERTY(bool, SupportsRecordingPlayCount)
+  KODI_SHIM_PROPERTY(bool, SupportsLastPlayedPosition)
+  KODI_SHIM_PROPERTY(bool, SupportsRecordingEdl)
+  KODI_SHIM_PROPERTY(bool, SupportsRecordingsRename)
+  KODI_SHIM_PROPERTY(bool, SupportsRecordingsLifetimeChange)
+  KODI_SHIM_PROPERTY(bool, SupportsDescrambleInfo)
+};
+
+class PVRChannel
+{
+  KODI_SHIM_PROPERTY(unsigned int, UniqueId)
+  KODI_SHIM_PROPERTY(bool, IsRadio)
+  KODI_SHIM_PROPERTY(unsigned int, ChannelNumber)
+  KODI_SHIM_PROPERTY(std::string, ChannelName)
+  KODI_SHIM_PROPERTY(std::string, IconPath)
+};
+
+class PVREPGTag
+{
+  KODI_SHIM_PROPERTY(unsigned int, UniqueBroadcastId)
+  KODI_SHIM_PROPERTY(unsigned int, UniqueChannelId)
+  KODI_SHIM_PROPERTY(std::string, Title)
+  KODI_SHIM_PROPERTY(time_t, StartTime)
+  KODI_SHIM_PROPERTY(time_t, EndTime)
+  KODI_SHIM_PROPERTY(std::string, PlotOutline)
+  KODI_SHIM_PROPERTY(std::string, Plot)
+  KODI_SHIM_PROPERTY(std::string, OriginalTitle)
+  KODI_SHIM_PROPERTY(std::string, Cast)
+  KODI_SHIM_PROPERTY(std::string, Director)
+  KODI_SHIM_PROPERTY(std::string, Writer)
+  KODI_SHIM_PROPERTY(int, Year)
+  KODI_SHIM_PROPERTY(std::string, IMDBNumber)
+  KODI_SHIM_PROPERTY(std::string, IconPath)
+  KODI_SHIM_PROPERTY(int, GenreType)
+  KODI_SHIM_PROPERTY(int, GenreSubType)
+  KODI_SHIM_PROPERTY(std::string, GenreDescription)
+  KODI_SHIM_PROPERTY(int, ParentalRating)
+  KODI_SHIM_PROPERTY(int, StarRating)
+  KODI_SHIM_PROPERTY(int, SeriesNumber)
+  KODI_SHIM_PROPERTY(int, EpisodeNumber)
+  KODI_SHIM_PROPERTY(int, EpisodePartNumber)
+  KODI_SHIM_PROPERTY(std::string, EpisodeName)
+  KODI_SHIM_PROPERTY(unsigned int, Flags)
+};
+
+class PVRRecording
+{
+  KODI_SHIM_PROPERTY(std::string, RecordingId)
+  KODI_SHIM_PROPERTY(std::string, Title)
+  KODI_SHIM_PROPERTY(std::string, EpisodeName)
+  KODI_SHIM_PROPERTY(int, SeriesNumber)
+  KODI_SHIM_PROPERTY(int, EpisodeNumber)
+  KODI_SHIM_PROPERTY(std::string, Directory)
+  KODI_SHIM_PROPERTY(std::string, PlotOutline)
+  KODI_SHIM_PROPERTY(std::string, Plot)
+  KODI_SHIM_PROPERTY(std::string, ChannelName)
+  KODI_SHIM_PROPERTY(std::string, IconPath)
+  KODI_SHIM_PROPERTY(time_t, RecordingTime)
+  KODI_SHIM_PROPERTY(int, Duration)
+  KODI_SHIM_PROPERTY(int, GenreType)
+  KODI_SHIM_PROPERTY(int, GenreSubType)
+  KODI_SHIM_PROPERTY(std::string, GenreDescription)
+  KODI_SHIM_PROPERTY(unsigned int, EPGEventId)
+  KODI_SHIM_PROPERTY(int, ChannelUid)
+  KODI_SHIM_PROPERTY(bool, IsDeleted)
+};
+
+class PVRTimer
+{
+  KODI_SHIM_PROPERTY(unsigned int, ClientIndex)
+  KODI_SHIM_PROPERTY(int, ClientChannelUid)
+  KODI_SHIM_PROPERTY(time_t, StartTime)
+  KODI_SHIM_PROPERTY(time_t, EndTime)
+  KODI_SHIM_PROPERTY(PVR_TIMER_STATE, State)
+  KODI_SHIM_PROPERTY(unsigned int, TimerType)
+  KODI_SHIM_PROPERTY(std::string, Title)
+  KODI_SHIM_PROPERTY(std::string, Summary)
+  KODI_SHIM_PROPERTY(int, GenreType)
+  KODI_SHIM_PROPERTY(int, GenreSubType)
+  KODI_SHIM_PROPERTY(unsigned int, EPGUid)
+};
+
+class PVRTimerType
+{
+  KODI_SHIM_PROPERTY(unsigned int, Id)
+  KODI_SHIM_PROPERTY(unsigned int, Attributes)
+  KODI_SHIM_PROPERTY(std::string, Description)
+};
+
+class PVREDLEntry
+{
+  KODI_SHIM_PROPERTY(int64_t, Start)
+  KODI_SHIM_PROPERTY(int64_t, End)
+  KODI_SHIM_PROPERTY(PVR_EDL_TYPE, Type)
+};
+
+class PVRStreamProperty
+{
+public:
+  PVRStreamProperty() = default;
+  PVRStreamProperty(const std::string& name, const std::string& value)
+    : m_name(name), m_value(value)
+  {
+  }
+  std::string GetName() const { return m_name; }
+  std::string GetValue() const { return m_value; }
+private:
+  std::string m_name;
+  std::string m_value;
+};
+
+template<class T>
+class PVRResultSet
+{
+public:
+  void Add(const T& item) { m_items.push_back(item); }
+  const std::vector<T>& Items() const { return m_items; }
+private:
+  std::vector<T> m_items;
+};
+
+class PVRChannelsResultSet : public PVRResultSet<PVRChannel> {};
+class PVREPGTagsResultSet : public PVRResultSet<PVREPGTag> {};
+class PVRRecordingsResultSet : public PVRResultSet<PVRRecording> {};
+class PVRTimersResultSet : public PVRResultSet<PVRTimer> {};
+
+class CInstancePVRClient
+{
+public:
+  CInstancePVRClient() = default;
+  virtual ~CInstancePVRClient() = default;
+
+  virtual PVR_ERROR GetCapabilities(PVRCapabilities& capabilities) = 0;
+  virtual PVR_ERROR GetBackendName(std::string& name) = 0;
+  virtual PVR_ERROR GetBackendVersion(std::string& version) = 0;
+  virtual PVR_ERROR GetConnectionString(std::string& connection)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+
+  virtual PVR_ERROR GetChannelsAmount(int& amount) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetChannels(bool radio, PVRChannelsResultSet& results)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+  virtual PVR_ERROR GetChannelStreamProperties(const PVRChannel& channel,
+      std::vector<PVRStreamProperty>& properties)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+
+  virtual PVR_ERROR GetEPGForChannel(int channelUid, time_t start, time_t end,
+      PVREPGTagsResultSet& results)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+  virtual PVR_ERROR IsEPGTagPlayable(const PVREPGTag& tag, bool& isPlayable)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+  virtual PVR_ERROR IsEPGTagRecordable(const PVREPGTag& tag, bool& isRecordable)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+  virtual PVR_ERROR GetEPGTagStreamProperties(const PVREPGTag& tag,
+      std::vector<PVRStreamProperty>& properties)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+  virtual PVR_ERROR GetEPGTagEdl(const PVREPGTag& tag, std::vector<PVREDLEntry>& edl)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+
+  virtual PVR_ERROR GetRecordingsAmount(bool deleted, int& amount)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+  virtual PVR_ERROR GetRecordings(bool deleted, PVRRecordingsResultSet& results)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+  virtual PVR_ERROR DeleteRecording(const PVRRecording& recording)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+  virtual PVR_ERROR GetRecordingEdl(const PVRRecording& recording,
+      std::vector<PVREDLEntry>& edl)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+  virtual PVR_ERROR GetRecordingStreamProperties(const PVRRecording& recording,
+      std::vector<PVRStreamProperty>& properties)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+
+  virtual PVR_ERROR GetTimerTypes(std::vector<PVRTimerType>& types)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+  virtual PVR_ERROR GetTimersAmount(int& amount) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetTimers(PVRTimersResultSet& results) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR AddTimer(const PVRTimer& timer) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR DeleteTimer(const PVRTimer& timer, bool forceDelete)
+  {
+    return PVR_ERROR_NOT_IMPLEMENTED;
+  }
+
+  std::string UserPath() const;
+  int EpgMaxPastDays() const;
+  int EpgMaxFutureDays() const;
+  void ConnectionStateChange(const std::string& connectionString,
+      PVR_CONNECTION_STATE newState, const std::string& message);
+  void EpgEventStateChange(PVREPGTag& tag, EPG_EVENT_STATE newState);
+  void TriggerTimerUpdate();
+  void TriggerRecordingUpdate();
+  void TriggerEpgUpdate(unsigned int channelUid);
+};
+
+} /* namespace addon */
+} /* namespace kodi */
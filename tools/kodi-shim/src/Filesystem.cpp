@@ -0,0 +1,489 @@
+#include "kodi/Filesystem.h"
+#include "ShimState.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <curl/curl.h>
+#include <filesystem>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// same limit as Kodi's curl file
+const long DEFAULT_REDIRECT_LIMIT = 5;
+const long CONNECT_TIMEOUT_SECONDS = 10;
+const long REQUEST_TIMEOUT_SECONDS = 60;
+
+std::string ToLower(std::string value)
+{
+  std::transform(value.begin(), value.end(), value.begin(),
+      [](unsigned char c) { return std::tolower(c); });
+  return value;
+}
+
+// the clock of file times is unspecified before C++20, convert through the current time
+time_t ToTimeT(fs::file_time_type fileTime)
+{
+  auto systemTime = std::chrono::system_clock::now() + std::chrono::duration_cast<
+      std::chrono::system_clock::duration>(fileTime - fs::file_time_type::clock::now());
+  return std::chrono::system_clock::to_time_t(systemTime);
+}
+
+bool StartsWith(const std::string& value, const std::string& prefix)
+{
+  return value.compare(0, prefix.size(), prefix) == 0;
+}
+
+std::string Base64Decode(const std::string& in)
+{
+  static const std::string chars =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  unsigned int buffer = 0;
+  int bits = 0;
+  for (char c : in)
+  {
+    if (c == '-')
+    {
+      c = '+';
+    }
+    else if (c == '_')
+    {
+      c = '/';
+    }
+    size_t value = chars.find(c);
+    if (value == std::string::npos)
+    {
+      continue;
+    }
+    buffer = (buffer << 6) | static_cast<unsigned int>(value);
+    bits += 6;
+    if (bits >= 8)
+    {
+      bits -= 8;
+      out += static_cast<char>((buffer >> bits) & 0xff);
+    }
+  }
+  return out;
+}
+
+std::string WithSlash(const std::string& path)
+{
+  if (path.empty() || path.back() == '/')
+  {
+    return path;
+  }
+  return path + "/";
+}
+
+} /* namespace */
+
+namespace kodi
+{
+namespace vfs
+{
+
+std::string TranslateSpecialProtocol(const std::string& source)
+{
+  const KodiShim::Config& config = KodiShim::GetConfig();
+  static const char* const addonPrefixes[] = { "special://home/addons/pvr.teleboy/",
+      "special://xbmc/addons/pvr.teleboy/" };
+  for (const char* prefix : addonPrefixes)
+  {
+    if (StartsWith(source, prefix))
+    {
+      return config.addonPath + source.substr(strlen(prefix));
+    }
+  }
+  static const char* const profilePrefixes[] = { "special://profile/", "special://userdata/",
+      "special://masterprofile/" };
+  for (const char* prefix : profilePrefixes)
+  {
+    if (StartsWith(source, prefix))
+    {
+      return config.profilePath + source.substr(strlen(prefix));
+    }
+  }
+  if (StartsWith(source, "special://temp/"))
+  {
+    return config.profilePath + "temp/" + source.substr(strlen("special://temp/"));
+  }
+  return source;
+}
+
+bool FileExists(const std::string& filename, bool usecache)
+{
+  std::error_code error;
+  return fs::is_regular_file(TranslateSpecialProtocol(filename), error);
+}
+
+bool DirectoryExists(const std::string& path)
+{
+  std::error_code error;
+  return fs::is_directory(TranslateSpecialProtocol(path), error);
+}
+
+bool CreateDirectory(const std::string& path)
+{
+  std::error_code error;
+  fs::create_directories(TranslateSpecialProtocol(path), error);
+  return !error;
+}
+
+bool RemoveDirectory(const std::string& path, bool recursive)
+{
+  std::error_code error;
+  std::string localPath = TranslateSpecialProtocol(path);
+  if (recursive)
+  {
+    return fs::remove_all(localPath, error) > 0 && !error;
+  }
+  return fs::remove(localPath, error) && !error;
+}
+
+bool DeleteFile(const std::string& filename)
+{
+  std::error_code error;
+  return fs::remove(TranslateSpecialProtocol(filename), error) && !error;
+}
+
+bool RenameFile(const std::string& filename, const std::string& newFileName)
+{
+  std::error_code error;
+  fs::rename(TranslateSpecialProtocol(filename), TranslateSpecialProtocol(newFileName), error);
+  return !error;
+}
+
+// Paths of the entries keep the protocol of the listed path, folders end
+// with a slash, as with Kodi.
+bool GetDirectory(const std::string& path, const std::string& mask,
+    std::vector<CDirEntry>& items)
+{
+  std::error_code error;
+  fs::directory_iterator it(TranslateSpecialProtocol(path), error);
+  if (error)
+  {
+    return false;
+  }
+  std::string base = WithSlash(path);
+  for (const fs::directory_entry& entry : it)
+  {
+    std::string name = entry.path().filename().string();
+    bool folder = entry.is_directory(error);
+    int64_t size = folder ? 0 : static_cast<int64_t>(entry.file_size(error));
+    items.emplace_back(name, folder ? base + name + "/" : base + name, folder, size,
+        ToTimeT(entry.last_write_time(error)));
+  }
+  return true;
+}
+
+class CFileImpl
+{
+public:
+  ~CFileImpl()
+  {
+    if (m_file != nullptr)
+    {
+      fclose(m_file);
+    }
+  }
+
+  FILE* m_file = nullptr;
+  bool m_write = false;
+
+  std::string m_url;
+  std::vector<std::pair<std::string, std::string>> m_options;
+  std::string m_body;
+  size_t m_position = 0;
+  std::string m_protocolLine;
+  std::vector<std::pair<std::string, std::string>> m_responseHeaders;
+
+  bool OpenLocal(const std::string& filename, const char* mode)
+  {
+    m_file = fopen(TranslateSpecialProtocol(filename).c_str(), mode);
+    return m_file != nullptr;
+  }
+
+  bool Perform();
+  ssize_t Read(void* ptr, size_t size)
+  {
+    if (m_file != nullptr)
+    {
+      return m_write ? -1 : static_cast<ssize_t>(fread(ptr, 1, size, m_file));
+    }
+    size_t count = std::min(size, m_body.size() - m_position);
+    memcpy(ptr, m_body.data() + m_position, count);
+    m_position += count;
+    return static_cast<ssize_t>(count);
+  }
+
+  static size_t OnBody(char* data, size_t size, size_t count, void* userdata)
+  {
+    static_cast<CFileImpl*>(userdata)->m_body.append(data, size * count);
+    return size * count;
+  }
+
+  // a new status line starts the headers of the next response of a redirect
+  static size_t OnHeader(char* data, size_t size, size_t count, void* userdata)
+  {
+    CFileImpl* impl = static_cast<CFileImpl*>(userdata);
+    std::string line(data, size * count);
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n'))
+    {
+      line.pop_back();
+    }
+    if (StartsWith(line, "HTTP/"))
+    {
+      impl->m_protocolLine = line;
+      impl->m_responseHeaders.clear();
+      return size * count;
+    }
+    size_t separator = line.find(':');
+    if (separator != std::string::npos)
+    {
+      size_t valueStart = line.find_first_not_of(' ', separator + 1);
+      impl->m_responseHeaders.emplace_back(ToLower(line.substr(0, separator)),
+          valueStart == std::string::npos ? "" : line.substr(valueStart));
+    }
+    return size * count;
+  }
+};
+
+bool CFileImpl::Perform()
+{
+  static std::once_flag curlInit;
+  std::call_once(curlInit, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+  CURL* curl = curl_easy_init();
+  if (curl == nullptr)
+  {
+    return false;
+  }
+  curl_slist* headers = nullptr;
+  std::string postData;
+  bool failOnError = true;
+  long redirectLimit = DEFAULT_REDIRECT_LIMIT;
+  curl_easy_setopt(curl, CURLOPT_URL, m_url.c_str());
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, CONNECT_TIMEOUT_SECONDS);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT_SECONDS);
+
+  // Kodi treats known names as options and sends the others as headers
+  for (const auto& option : m_options)
+  {
+    std::string name = ToLower(option.first);
+    const std::string& value = option.second;
+    if (name == "customrequest")
+    {
+      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, value.c_str());
+    }
+    else if (name == "postdata")
+    {
+      postData = Base64Decode(value);
+    }
+    else if (name == "acceptencoding" || name == "encoding")
+    {
+      curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, value.c_str());
+    }
+    else if (name == "cookie")
+    {
+      curl_easy_setopt(curl, CURLOPT_COOKIE, value.c_str());
+    }
+    else if (name == "referer")
+    {
+      curl_easy_setopt(curl, CURLOPT_REFERER, value.c_str());
+    }
+    else if (name == "user-agent" || name == "useragent")
+    {
+      curl_easy_setopt(curl, CURLOPT_USERAGENT, value.c_str());
+    }
+    else if (name == "failonerror")
+    {
+      failOnError = value == "true";
+    }
+    else if (name == "redirect-limit")
+    {
+      redirectLimit = std::atol(value.c_str());
+    }
+    else if (name == "connection-timeout")
+    {
+      curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, std::atol(value.c_str()));
+    }
+    else if (name == "verifypeer")
+    {
+      curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, value == "false" ? 0L : 1L);
+    }
+    else
+    {
+      headers = curl_slist_append(headers, (option.first + ": " + value).c_str());
+    }
+  }
+  if (!postData.empty())
+  {
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(postData.size()));
+  }
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, redirectLimit > 0 ? 1L : 0L);
+  curl_easy_setopt(curl, CURLOPT_MAXREDIRS, redirectLimit);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &CFileImpl::OnBody);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &CFileImpl::OnHeader);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
+
+  CURLcode result = curl_easy_perform(curl);
+  long responseCode = 0;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+  curl_slist_free_all(headers);
+  curl_easy_cleanup(curl);
+  if (result != CURLE_OK)
+  {
+    kodi::Log(ADDON_LOG_DEBUG, "CURL request to %s failed: %s", m_url.c_str(),
+        curl_easy_strerror(result));
+    return false;
+  }
+  return !failOnError || responseCode < 400;
+}
+
+CFile::CFile() = default;
+
+CFile::~CFile() = default;
+
+bool CFile::OpenFile(const std::string& filename, unsigned int flags)
+{
+  m_impl.reset(new CFileImpl());
+  return m_impl->OpenLocal(filename, "rb");
+}
+
+bool CFile::OpenFileForWrite(const std::string& filename, bool overwrite)
+{
+  if (!overwrite && FileExists(filename))
+  {
+    return false;
+  }
+  m_impl.reset(new CFileImpl());
+  m_impl->m_write = true;
+  return m_impl->OpenLocal(filename, "wb");
+}
+
+void CFile::Close()
+{
+  m_impl.reset();
+}
+
+bool CFile::CURLCreate(const std::string& url)
+{
+  m_impl.reset(new CFileImpl());
+  m_impl->m_url = url;
+  return true;
+}
+
+bool CFile::CURLAddOption(CURLOptiontype type, const std::string& name,
+    const std::string& value)
+{
+  if (!m_impl)
+  {
+    return false;
+  }
+  m_impl->m_options.emplace_back(name, value);
+  return true;
+}
+
+bool CFile::CURLOpen(unsigned int flags)
+{
+  if (!m_impl)
+  {
+    return false;
+  }
+  if (StartsWith(m_impl->m_url, "http://") || StartsWith(m_impl->m_url, "https://"))
+  {
+    return m_impl->Perform();
+  }
+  return m_impl->OpenLocal(m_impl->m_url, "rb");
+}
+
+ssize_t CFile::Read(void* ptr, size_t size)
+{
+  return m_impl ? m_impl->Read(ptr, size) : -1;
+}
+
+bool CFile::ReadLine(std::string& line)
+{
+  line.clear();
+  char c;
+  ssize_t count;
+  while ((count = Read(&c, 1)) == 1 && c != '\n')
+  {
+    line += c;
+  }
+  if (!line.empty() && line.back() == '\r')
+  {
+    line.pop_back();
+  }
+  return count == 1 || !line.empty();
+}
+
+ssize_t CFile::Write(const void* ptr, size_t size)
+{
+  if (!m_impl || m_impl->m_file == nullptr || !m_impl->m_write)
+  {
+    return -1;
+  }
+  return static_cast<ssize_t>(fwrite(ptr, 1, size, m_impl->m_file));
+}
+
+int64_t CFile::GetLength() const
+{
+  if (!m_impl)
+  {
+    return -1;
+  }
+  if (m_impl->m_file == nullptr)
+  {
+    return static_cast<int64_t>(m_impl->m_body.size());
+  }
+  long position = ftell(m_impl->m_file);
+  fseek(m_impl->m_file, 0, SEEK_END);
+  long length = ftell(m_impl->m_file);
+  fseek(m_impl->m_file, position, SEEK_SET);
+  return length;
+}
+
+std::string CFile::GetPropertyValue(FilePropertyTypes type, const std::string& name) const
+{
+  std::vector<std::string> values = GetPropertyValues(type, name);
+  return values.empty() ? "" : values.back();
+}
+
+std::vector<std::string> CFile::GetPropertyValues(FilePropertyTypes type,
+    const std::string& name) const
+{
+  std::vector<std::string> values;
+  if (!m_impl)
+  {
+    return values;
+  }
+  if (type == ADDON_FILE_PROPERTY_RESPONSE_PROTOCOL)
+  {
+    values.push_back(m_impl->m_protocolLine);
+    return values;
+  }
+  if (type == ADDON_FILE_PROPERTY_RESPONSE_HEADER)
+  {
+    std::string lowerName = ToLower(name);
+    for (const auto& header : m_impl->m_responseHeaders)
+    {
+      if (header.first == lowerName)
+      {
+        values.push_back(header.second);
+      }
+    }
+  }
+  return values;
+}
+
+} /* namespace vfs */
+} /* namespace kodi */
@@ -0,0 +1,359 @@
+#include "KodiShim.h"
+#include "ShimState.h"
+#include <condition_variable>
+#include <cstdarg>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+std::mutex configMutex;
+KodiShim::Config config;
+std::map<std::string, std::string> settings;
+std::map<uint32_t, std::string> localizedStrings;
+
+std::mutex recorderMutex;
+std::condition_variable recorderCondition;
+std::vector<KodiShim::EpgEvent> epgEvents;
+size_t epgEventCount = 0;
+std::chrono::steady_clock::time_point lastEpgEvent;
+std::vector<KodiShim::ConnectionEvent> connectionEvents;
+std::vector<KodiShim::Notification> notifications;
+int timerUpdates = 0;
+int recordingUpdates = 0;
+
+std::mutex logMutex;
+
+std::string Trim(const std::string& value)
+{
+  size_t begin = value.find_first_not_of(" \t\r");
+  if (begin == std::string::npos)
+  {
+    return "";
+  }
+  size_t end = value.find_last_not_of(" \t\r");
+  return value.substr(begin, end - begin + 1);
+}
+
+bool LoadSettings(const std::string& path)
+{
+  settings.clear();
+  if (path.empty())
+  {
+    return true;
+  }
+  std::ifstream file(path);
+  if (!file)
+  {
+    std::cerr << "Could not read settings file " << path << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line))
+  {
+    line = Trim(line);
+    size_t separator = line.find('=');
+    if (line.empty() || line[0] == '#' || separator == std::string::npos)
+    {
+      continue;
+    }
+    settings[Trim(line.substr(0, separator))] = Trim(line.substr(separator + 1));
+  }
+  return true;
+}
+
+// msgctxt "#30101" followed by msgid "..." in the english strings.po
+void LoadLocalizedStrings(const std::string& addonPath)
+{
+  localizedStrings.clear();
+  std::ifstream file(addonPath + "resources/language/resource.language.en_gb/strings.po");
+  std::string line;
+  uint32_t labelId = 0;
+  while (std::getline(file, line))
+  {
+    if (line.compare(0, 10, "msgctxt \"#") == 0)
+    {
+      labelId = static_cast<uint32_t>(std::strtoul(line.c_str() + 10, nullptr, 10));
+    }
+    else if (labelId != 0 && line.compare(0, 7, "msgid \"") == 0)
+    {
+      size_t end = line.rfind('"');
+      localizedStrings[labelId] = line.substr(7, end > 7 ? end - 7 : 0);
+      labelId = 0;
+    }
+  }
+}
+
+std::string WithSlash(const std::string& path)
+{
+  if (path.empty() || path.back() == '/')
+  {
+    return path;
+  }
+  return path + "/";
+}
+
+} /* namespace */
+
+namespace KodiShim
+{
+
+bool Init(const Config& newConfig)
+{
+  std::lock_guard<std::mutex> lock(configMutex);
+  config = newConfig;
+  config.profilePath = WithSlash(fs::absolute(config.profilePath).string());
+  config.addonPath = WithSlash(fs::absolute(config.addonPath).string());
+  std::error_code error;
+  fs::create_directories(config.profilePath + "addon_data/pvr.teleboy", error);
+  if (error)
+  {
+    std::cerr << "Could not create profile " << config.profilePath << ": "
+        << error.message() << std::endl;
+    return false;
+  }
+  LoadLocalizedStrings(config.addonPath);
+  return LoadSettings(config.settingsFile);
+}
+
+const Config& GetConfig()
+{
+  return config;
+}
+
+kodi::addon::CInstancePVRClient* CreateAddon()
+{
+  kodi::addon::CAddonBase* addon = KodiShimCreateAddon();
+  auto client = dynamic_cast<kodi::addon::CInstancePVRClient*>(addon);
+  if (client == nullptr || addon->Create() != ADDON_STATUS_OK)
+  {
+    delete addon;
+    return nullptr;
+  }
+  return client;
+}
+
+void DestroyAddon(kodi::addon::CInstancePVRClient* client)
+{
+  delete dynamic_cast<kodi::addon::CAddonBase*>(client);
+}
+
+std::vector<EpgEvent> Recorder::TakeEpgEvents()
+{
+  std::lock_guard<std::mutex> lock(recorderMutex);
+  std::vector<EpgEvent> events;
+  events.swap(epgEvents);
+  return events;
+}
+
+size_t Recorder::GetEpgEventCount()
+{
+  std::lock_guard<std::mutex> lock(recorderMutex);
+  return epgEventCount;
+}
+
+std::vector<ConnectionEvent> Recorder::GetConnectionEvents()
+{
+  std::lock_guard<std::mutex> lock(recorderMutex);
+  return connectionEvents;
+}
+
+std::vector<Notification> Recorder::GetNotifications()
+{
+  std::lock_guard<std::mutex> lock(recorderMutex);
+  return notifications;
+}
+
+int Recorder::GetTimerUpdates()
+{
+  std::lock_guard<std::mutex> lock(recorderMutex);
+  return timerUpdates;
+}
+
+int Recorder::GetRecordingUpdates()
+{
+  std::lock_guard<std::mutex> lock(recorderMutex);
+  return recordingUpdates;
+}
+
+bool Recorder::WaitForConnectionState(PVR_CONNECTION_STATE state,
+    std::chrono::milliseconds timeout)
+{
+  std::unique_lock<std::mutex> lock(recorderMutex);
+  return recorderCondition.wait_for(lock, timeout, [state] {
+    return !connectionEvents.empty() && connectionEvents.back().state == state;
+  });
+}
+
+bool Recorder::WaitForEpgQuiet(std::chrono::milliseconds quietPeriod,
+    std::chrono::milliseconds timeout)
+{
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  std::unique_lock<std::mutex> lock(recorderMutex);
+  while (true)
+  {
+    auto now = std::chrono::steady_clock::now();
+    if (!epgEvents.empty() && lastEpgEvent + quietPeriod <= now)
+    {
+      return true;
+    }
+    if (now >= deadline)
+    {
+      return false;
+    }
+    recorderCondition.wait_for(lock, std::chrono::milliseconds(50));
+  }
+}
+
+void Recorder::Clear()
+{
+  std::lock_guard<std::mutex> lock(recorderMutex);
+  epgEvents.clear();
+  epgEventCount = 0;
+  connectionEvents.clear();
+  notifications.clear();
+  timerUpdates = 0;
+  recordingUpdates = 0;
+}
+
+} /* namespace KodiShim */
+
+namespace kodi
+{
+
+void Log(const AddonLog loglevel, const char* format, ...)
+{
+  static const char* const levels[] = { "debug", "info", "warning", "error", "fatal" };
+  if (loglevel < KodiShim::GetConfig().logLevel)
+  {
+    return;
+  }
+  char message[16384];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+
+  auto now = std::chrono::system_clock::now();
+  time_t seconds = std::chrono::system_clock::to_time_t(now);
+  int millis = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+      now.time_since_epoch()).count() % 1000);
+  struct tm tm;
+  localtime_r(&seconds, &tm);
+  char timestamp[16];
+  strftime(timestamp, sizeof(timestamp), "%H:%M:%S", &tm);
+
+  std::lock_guard<std::mutex> lock(logMutex);
+  fprintf(stderr, "%s.%03d T:%zx %7s <pvr.teleboy>: %s\n", timestamp, millis,
+      std::hash<std::thread::id>()(std::this_thread::get_id()) & 0xffff, levels[loglevel],
+      message);
+}
+
+void QueueNotification(QueueMsg type, const std::string& header, const std::string& message)
+{
+  kodi::Log(ADDON_LOG_INFO, "Notification: %s", message.c_str());
+  std::lock_guard<std::mutex> lock(recorderMutex);
+  notifications.push_back({ type, message });
+}
+
+namespace addon
+{
+
+std::string GetSettingString(const std::string& settingName, const std::string& defaultValue)
+{
+  std::lock_guard<std::mutex> lock(configMutex);
+  auto setting = settings.find(settingName);
+  return setting == settings.end() ? defaultValue : setting->second;
+}
+
+bool GetSettingBoolean(const std::string& settingName, bool defaultValue)
+{
+  std::string value = GetSettingString(settingName, defaultValue ? "true" : "false");
+  return CSettingValue(value).GetBoolean();
+}
+
+int GetSettingInt(const std::string& settingName, int defaultValue)
+{
+  std::string value = GetSettingString(settingName, std::to_string(defaultValue));
+  return CSettingValue(value).GetInt();
+}
+
+std::string GetLocalizedString(uint32_t labelId, const std::string& defaultStr)
+{
+  std::lock_guard<std::mutex> lock(configMutex);
+  auto label = localizedStrings.find(labelId);
+  return label == localizedStrings.end() ? defaultStr : label->second;
+}
+
+std::string GetAddonPath(const std::string& append)
+{
+  return KodiShim::GetConfig().addonPath + append;
+}
+
+std::string GetUserPath(const std::string& append)
+{
+  return KodiShim::GetConfig().profilePath + "addon_data/pvr.teleboy/" + append;
+}
+
+std::string CInstancePVRClient::UserPath() const
+{
+  return GetUserPath();
+}
+
+int CInstancePVRClient::EpgMaxPastDays() const
+{
+  return KodiShim::GetConfig().epgMaxPastDays;
+}
+
+int CInstancePVRClient::EpgMaxFutureDays() const
+{
+  return KodiShim::GetConfig().epgMaxFutureDays;
+}
+
+void CInstancePVRClient::ConnectionStateChange(const std::string& connectionString,
+    PVR_CONNECTION_STATE newState, const std::string& message)
+{
+  kodi::Log(ADDON_LOG_DEBUG, "Connection state: %s (%i)", connectionString.c_str(), newState);
+  {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    connectionEvents.push_back({ connectionString, newState, message,
+        std::chrono::steady_clock::now() });
+  }
+  recorderCondition.notify_all();
+}
+
+void CInstancePVRClient::EpgEventStateChange(PVREPGTag& tag, EPG_EVENT_STATE newState)
+{
+  {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    lastEpgEvent = std::chrono::steady_clock::now();
+    epgEvents.push_back({ tag, newState, lastEpgEvent });
+    epgEventCount++;
+  }
+  recorderCondition.notify_all();
+}
+
+void CInstancePVRClient::TriggerTimerUpdate()
+{
+  std::lock_guard<std::mutex> lock(recorderMutex);
+  timerUpdates++;
+}
+
+void CInstancePVRClient::TriggerRecordingUpdate()
+{
+  std::lock_guard<std::mutex> lock(recorderMutex);
+  recordingUpdates++;
+}
+
+void CInstancePVRClient::TriggerEpgUpdate(unsigned int channelUid)
+{
+}
+
+} /* namespace addon */
+} /* namespace kodi */
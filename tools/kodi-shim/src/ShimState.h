@@ -0,0 +1,11 @@
+#pragma once
+
+#include "KodiShim.h"
+
+namespace KodiShim
+{
+
+// set by Init before the add-on is created and not changed afterwards
+const Config& GetConfig();
+
+} /* namespace KodiShim */
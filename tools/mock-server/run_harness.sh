@@ -0,0 +1,77 @@
+#!/bin/bash
+# Runs tools/harness against the mock server: a cold start on an empty profile,
+# a warm start on the profile the cold start left behind and a cold start with
+# injected 5xx and 429 responses. The reports are written to the output
+# directory together with the request statistics of the mock.
+#
+# Usage: run_harness.sh BUILD_DIR [OUTPUT_DIR]
+# The build has to be configured with TELEBOY_API_URL=http://127.0.0.1:$PORT/api
+# and TELEBOY_WEB_URL=http://127.0.0.1:$PORT/web.
+
+set -e
+
+BUILD_DIR=$(realpath "${1:?Usage: $0 BUILD_DIR [OUTPUT_DIR]}")
+OUTPUT_DIR=$(realpath -m "${2:-harness-results}")
+PORT=${PORT:-18080}
+# a channel list and the epg window of a default Kodi installation
+STATIONS=${STATIONS:-100}
+PAST_DAYS=${PAST_DAYS:-1}
+FUTURE_DAYS=${FUTURE_DAYS:-3}
+LATENCY=${LATENCY:-40}
+JITTER=${JITTER:-20}
+MAX_COLD_EPG_REFILL=${MAX_COLD_EPG_REFILL:-60000}
+MAX_WARM_EPG_REFILL=${MAX_WARM_EPG_REFILL:-5000}
+MAX_ZAP=${MAX_ZAP:-1000}
+
+MOCK_DIR=$(dirname "$(realpath "$0")")
+HARNESS="$BUILD_DIR/teleboy_harness"
+MOCK_PID=
+
+mkdir -p "$OUTPUT_DIR"
+rm -rf "$OUTPUT_DIR"/profile-*
+printf 'username=user@example.com\npassword=secret\n' > "$OUTPUT_DIR/mock.settings"
+
+stop_mock() {
+  if [ -n "$MOCK_PID" ]; then
+    curl -s "http://127.0.0.1:$PORT/__stats" > "$OUTPUT_DIR/$1-stats.json" || true
+    kill "$MOCK_PID" 2> /dev/null || true
+    wait "$MOCK_PID" 2> /dev/null || true
+    MOCK_PID=
+  fi
+}
+trap 'stop_mock aborted' EXIT
+
+start_mock() {
+  python3 "$MOCK_DIR/teleboy_mock.py" --port "$PORT" --quiet --stations "$STATIONS" \
+      --latency "$LATENCY" --jitter "$JITTER" --seed 1 "$@" > "$OUTPUT_DIR/mock.log" 2>&1 &
+  MOCK_PID=$!
+  for _ in $(seq 50); do
+    if curl -s -o /dev/null "http://127.0.0.1:$PORT/__stats"; then
+      return 0
+    fi
+    sleep 0.1
+  done
+  echo "The mock server did not start" >&2
+  cat "$OUTPUT_DIR/mock.log" >&2
+  exit 1
+}
+
+run_harness() {
+  local name=$1
+  local profile=$2
+  shift 2
+  echo "== $name"
+  "$HARNESS" --settings "$OUTPUT_DIR/mock.settings" --profile "$OUTPUT_DIR/$profile" \
+      --channels 0 --past-days "$PAST_DAYS" --future-days "$FUTURE_DAYS" --zaps 12 --timeout 300 \
+      --report "$OUTPUT_DIR/$name.json" "$@"
+}
+
+start_mock
+run_harness cold profile-clean --max-epg-refill "$MAX_COLD_EPG_REFILL" --max-zap "$MAX_ZAP"
+# a second process, the cache and the session of the cold start are reused
+run_harness warm profile-clean --max-epg-refill "$MAX_WARM_EPG_REFILL" --max-zap "$MAX_ZAP"
+stop_mock clean
+
+start_mock --error-rate 0.1 --rate-limit-rate 0.1
+run_harness faults profile-faults
+stop_mock faults
@@ -0,0 +1,381 @@
+#!/usr/bin/env python3
+"""Stand-in for the Teleboy website and TV API, serving the fixtures in
+fixtures/ so the add-on can be run and measured without network access.
+
+The website is served below /web and the API below /api, matching
+-DTELEBOY_WEB_URL=http://HOST:PORT/web and -DTELEBOY_API_URL=http://HOST:PORT/api.
+Stream urls point to /cdn, which redirects once before serving a manifest.
+
+Faults can be injected into the requests matching --fault-paths: --latency
+and --jitter delay every response, --error-rate answers with a 5xx status and
+--rate-limit-rate with 429 and a Retry-After header. GET /__stats returns the
+request and fault counts per endpoint, POST /__reset clears them.
+"""
+
+import argparse
+import datetime
+import json
+import os
+import random
+import re
+import secrets
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlsplit
+
+FIXTURE_TZ = datetime.timezone(datetime.timedelta(hours=1))
+API_KEY = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+USER_ID = "1234567"
+MANIFEST = ('<?xml version="1.0" encoding="utf-8"?>\n'
+            '<MPD xmlns="urn:mpeg:dash:schema:mpd:2011" type="dynamic"'
+            ' profiles="urn:mpeg:dash:profile:isoff-live:2011"/>\n')
+
+
+def load_json(fixtures, name):
+    with open(os.path.join(fixtures, "api", name), encoding="utf-8") as f:
+        return json.load(f)
+
+
+def load_html(fixtures, name):
+    with open(os.path.join(fixtures, "web", name), encoding="utf-8") as f:
+        return f.read()
+
+
+def parse_fixture_time(value):
+    return datetime.datetime.fromisoformat(value)
+
+
+def format_time(epoch):
+    return datetime.datetime.fromtimestamp(epoch, FIXTURE_TZ).isoformat()
+
+
+def parse_query_time(value):
+    # the add-on sends "YYYY-MM-DD+HH:MM:SS" in UTC, the '+' arrives as a space
+    parsed = datetime.datetime.strptime(value.replace("+", " "), "%Y-%m-%d %H:%M:%S")
+    return parsed.replace(tzinfo=datetime.timezone.utc).timestamp()
+
+
+class Fixtures:
+    def __init__(self, path, station_count=0):
+        self.stations = load_json(path, "epg_stations.json")
+        self.genres = load_json(path, "epg_genres.json")
+        self.user_stations = load_json(path, "user_stations.json")
+        self.add_stations(station_count)
+        self.recordings_ready = load_json(path, "recordings_ready.json")["data"]["items"]
+        planned = load_json(path, "recordings_planned.json")
+        self.stream = load_json(path, "stream.json")
+        self.live_anonymous = load_html(path, "live_anonymous.html")
+        self.login = load_html(path, "login.html")
+        self.home = load_html(path, "home_authenticated.html")
+
+        # the recorded day is repeated for every day, each station follows
+        # one of its schedules
+        day = load_json(path, "broadcasts_day.json")
+        day_start = datetime.datetime.fromisoformat(day["date"] + "T00:00:00" + day["timezone"])
+        self.schedules = []
+        for schedule in day["schedules"]:
+            programmes = []
+            for item in schedule:
+                programme = dict(item)
+                programme["begin"] = (parse_fixture_time(item["begin"]) - day_start).total_seconds()
+                programme["end"] = (parse_fixture_time(item["end"]) - day_start).total_seconds()
+                programmes.append(programme)
+            self.schedules.append(programmes)
+        self.station_ids = sorted(s["id"] for s in self.stations["data"]["items"])
+
+        # planned recordings are moved to the days after today
+        planned_date = datetime.date.fromisoformat(planned["date"])
+        shift = (datetime.datetime.now(FIXTURE_TZ).date() - planned_date).days + 1
+        self.recordings_planned = []
+        for item in planned["data"]["items"]:
+            item = dict(item)
+            for field in ("begin", "end"):
+                moved = parse_fixture_time(item[field]) + datetime.timedelta(days=shift)
+                item[field] = moved.isoformat()
+            self.recordings_planned.append(item)
+
+    def add_stations(self, station_count):
+        """Repeats the fixture stations under new ids up to station_count
+        stations, for measurements with a realistic channel list."""
+        stations = self.stations["data"]["items"]
+        order = self.user_stations["data"]["items"]
+        originals = list(stations)
+        next_id = max(s["id"] for s in originals) + 1
+        while len(stations) < station_count:
+            station = dict(originals[len(stations) % len(originals)])
+            station["name"] = "%s %d" % (station["name"], len(stations) // len(originals) + 1)
+            station["label"] = "%s%d" % (station["label"], next_id)
+            station["id"] = next_id
+            stations.append(station)
+            order.append(next_id)
+            next_id += 1
+        self.stations["data"]["total"] = len(stations)
+
+    def broadcasts(self, begin, end, station):
+        stations = [station] if station is not None else self.station_ids
+        day = 24 * 60 * 60
+        offset = FIXTURE_TZ.utcoffset(None).total_seconds()
+        first_day = int((begin + offset) // day) - 1
+        last_day = int((end + offset) // day)
+        items = []
+        for station_id in stations:
+            if station_id not in self.station_ids:
+                continue
+            index = self.station_ids.index(station_id)
+            schedule = self.schedules[index % len(self.schedules)]
+            for day_number in range(first_day, last_day + 1):
+                day_start = day_number * day - offset
+                for programme in schedule:
+                    programme_begin = day_start + programme["begin"]
+                    programme_end = day_start + programme["end"]
+                    if programme_begin >= end or programme_end <= begin:
+                        continue
+                    item = {k: v for k, v in programme.items() if k != "slot"}
+                    item["id"] = ((day_number % 1000) * 2000 + index) * 50 + programme["slot"]
+                    item["station_id"] = station_id
+                    item["begin"] = format_time(programme_begin)
+                    item["end"] = format_time(programme_end)
+                    items.append(item)
+        return items
+
+
+class Statistics:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        self.requests = {}
+        self.faults = {}
+
+    def count(self, table, endpoint):
+        with self.lock:
+            table[endpoint] = table.get(endpoint, 0) + 1
+
+    def snapshot(self):
+        with self.lock:
+            return {"requests": dict(self.requests), "faults": dict(self.faults)}
+
+
+def endpoint_of(path):
+    if path.startswith("/web"):
+        return "login"
+    if path.startswith("/cdn"):
+        return "cdn"
+    for name in ("epg/stations", "epg/genres", "broadcasts", "recordings", "stream"):
+        if "/" + name in path:
+            return name
+    if path.endswith("/stations"):
+        return "stations"
+    return "other"
+
+
+class Handler(BaseHTTPRequestHandler):
+    server_version = "TeleboyMock/1.0"
+
+    def log_message(self, format, *args):
+        if not self.server.options.quiet:
+            sys.stderr.write("%s %s\n" % (self.log_date_time_string(), format % args))
+
+    def do_GET(self):
+        self.handle_request("GET")
+
+    def do_POST(self):
+        self.handle_request("POST")
+
+    def do_DELETE(self):
+        self.handle_request("DELETE")
+
+    def handle_request(self, method):
+        url = urlsplit(self.path)
+        path = url.path.rstrip("/") or "/"
+        query = {k: v[-1] for k, v in parse_qs(url.query, keep_blank_values=True).items()}
+        length = int(self.headers.get("Content-Length", 0) or 0)
+        body = self.rfile.read(length).decode("utf-8", "replace") if length else ""
+
+        if path == "/__stats":
+            return self.send_json(200, self.server.statistics.snapshot())
+        if path == "/__reset":
+            self.server.statistics.reset()
+            return self.send_json(200, {"success": True})
+
+        options = self.server.options
+        endpoint = endpoint_of(path)
+        self.server.statistics.count(self.server.statistics.requests, endpoint)
+        delay = options.latency + (random.uniform(0, options.jitter) if options.jitter else 0)
+        if delay > 0:
+            time.sleep(delay / 1000.0)
+        if self.server.fault_paths.search(path):
+            roll = random.random()
+            if roll < options.rate_limit_rate:
+                self.server.statistics.count(self.server.statistics.faults, endpoint + ":429")
+                return self.send_json(429, {"success": False, "error_code": 429},
+                                      {"Retry-After": str(options.retry_after)})
+            if roll < options.rate_limit_rate + options.error_rate:
+                status = random.choice((500, 502, 503))
+                self.server.statistics.count(self.server.statistics.faults, endpoint + ":%d" % status)
+                return self.send_json(status, {"success": False, "error_code": status})
+
+        if path.startswith("/web"):
+            return self.handle_web(method, path[len("/web"):] or "/", body)
+        if path.startswith("/api"):
+            return self.handle_api(method, path[len("/api"):], query, body)
+        if path.startswith("/cdn"):
+            return self.handle_cdn(path)
+        self.send_json(404, {"success": False, "error_code": 404})
+
+    def base_url(self):
+        return "http://%s" % self.headers.get("Host", "%s:%d" % self.server.server_address[:2])
+
+    def session(self):
+        cookies = self.headers.get("Cookie", "")
+        match = re.search(r"cinergy_s=([^;\s]+)", cookies)
+        token = self.headers.get("x-teleboy-session") or (match.group(1) if match else None)
+        return token if token in self.server.sessions else None
+
+    def handle_web(self, method, path, body):
+        if method == "POST" and path == "/login_check":
+            form = {k: v[-1] for k, v in parse_qs(body).items()}
+            options = self.server.options
+            if form.get("login") != options.username or form.get("password") != options.password:
+                return self.send_html(401, self.server.fixtures.login)
+            token = secrets.token_hex(16)
+            with self.server.sessions_lock:
+                self.server.sessions.add(token)
+            return self.send_redirect(self.base_url() + "/web",
+                                      {"Set-Cookie": "cinergy_s=%s; path=/; HttpOnly" % token})
+        if method != "GET":
+            return self.send_html(405, "")
+        if path == "/login":
+            return self.send_html(200, self.server.fixtures.login)
+        if path in ("/", "/live"):
+            if self.session() is None:
+                return self.send_html(200, self.server.fixtures.live_anonymous)
+            home = self.server.fixtures.home.replace("{api_key}", API_KEY)
+            home = home.replace("{user_id}", USER_ID).replace("{base}", self.base_url())
+            return self.send_html(200, home)
+        self.send_html(404, "")
+
+    def handle_api(self, method, path, query, body):
+        if self.headers.get("x-teleboy-apikey") != API_KEY:
+            return self.send_json(401, {"success": False, "error_code": 10401})
+        if self.session() is None:
+            return self.send_json(403, {"success": False, "error_code": 10403})
+        fixtures = self.server.fixtures
+        if path == "/epg/stations":
+            return self.send_json(200, fixtures.stations)
+        if path == "/epg/genres":
+            return self.send_json(200, fixtures.genres)
+
+        match = re.match(r"^/users/(\d+)(/.*)$", path)
+        if not match or match.group(1) != USER_ID:
+            return self.send_json(404, {"success": False, "error_code": 404})
+        path = match.group(2)
+        if path == "/stations":
+            return self.send_json(200, fixtures.user_stations)
+        if path == "/broadcasts":
+            station = int(query["station"]) if "station" in query else None
+            items = fixtures.broadcasts(parse_query_time(query["begin"]),
+                                        parse_query_time(query["end"]), station)
+            return self.send_page(items, query)
+        if path in ("/recordings/ready", "/recordings/planned"):
+            with self.server.recordings_lock:
+                items = list(fixtures.recordings_ready if path.endswith("ready")
+                             else fixtures.recordings_planned)
+            return self.send_page(items, query)
+        if path == "/recordings" and method == "POST":
+            return self.send_json(200, {"success": True, "status": 200})
+        match = re.match(r"^/recordings/(\d+)$", path)
+        if match and method == "DELETE":
+            recording_id = int(match.group(1))
+            with self.server.recordings_lock:
+                for items in (fixtures.recordings_ready, fixtures.recordings_planned):
+                    items[:] = [item for item in items if item["id"] != recording_id]
+            return self.send_json(200, {"success": True, "status": 200})
+        match = re.match(r"^/stream/(?:live/)?(\d+)$", path)
+        if match:
+            stream = json.loads(json.dumps(fixtures.stream).replace("{base}", self.base_url())
+                                .replace("{id}", match.group(1)))
+            return self.send_json(200, stream)
+        self.send_json(404, {"success": False, "error_code": 404})
+
+    def handle_cdn(self, path):
+        match = re.match(r"^/cdn/redirect/(\d+)/manifest.mpd$", path)
+        if match:
+            return self.send_redirect(self.base_url() + "/cdn/edge/%s/manifest.mpd" % match.group(1))
+        if path.startswith("/cdn/edge/"):
+            return self.send_body(200, MANIFEST.encode(), "application/dash+xml")
+        self.send_body(404, b"", "text/plain")
+
+    def send_page(self, items, query):
+        skip = int(query.get("skip", 0))
+        limit = int(query.get("limit", len(items) or 1))
+        self.send_json(200, {"success": True, "status": 200,
+                             "data": {"total": len(items), "items": items[skip:skip + limit]}})
+
+    def send_json(self, status, content, headers=None):
+        body = json.dumps(content, ensure_ascii=False).encode("utf-8")
+        self.send_body(status, body, "application/json", headers)
+
+    def send_html(self, status, content):
+        self.send_body(status, content.encode("utf-8"), "text/html; charset=utf-8")
+
+    def send_redirect(self, location, headers=None):
+        headers = dict(headers or {})
+        headers["Location"] = location
+        self.send_body(302, b"", "text/html", headers)
+
+    def send_body(self, status, body, content_type, headers=None):
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.end_headers()
+        self.wfile.write(body)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--fixtures", default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                           "fixtures"))
+    parser.add_argument("--stations", type=int, default=0,
+                        help="repeat the fixture stations up to this many stations")
+    parser.add_argument("--username", default="user@example.com")
+    parser.add_argument("--password", default="secret")
+    parser.add_argument("--latency", type=float, default=0, help="delay of every response in ms")
+    parser.add_argument("--jitter", type=float, default=0, help="random additional delay up to ms")
+    parser.add_argument("--error-rate", type=float, default=0, help="share of 5xx responses")
+    parser.add_argument("--rate-limit-rate", type=float, default=0, help="share of 429 responses")
+    parser.add_argument("--retry-after", type=int, default=1, help="Retry-After of 429 responses in s")
+    parser.add_argument("--fault-paths", default=r"^/api/",
+                        help="regular expression of the paths faults are injected into")
+    parser.add_argument("--seed", type=int, help="seed of the fault injection")
+    parser.add_argument("--quiet", action="store_true", help="do not log requests")
+    options = parser.parse_args()
+    if options.seed is not None:
+        random.seed(options.seed)
+
+    server = ThreadingHTTPServer((options.host, options.port), Handler)
+    server.daemon_threads = True
+    server.options = options
+    server.fixtures = Fixtures(options.fixtures, options.stations)
+    server.fault_paths = re.compile(options.fault_paths)
+    server.statistics = Statistics()
+    server.sessions = set()
+    server.sessions_lock = threading.Lock()
+    server.recordings_lock = threading.Lock()
+    sys.stderr.write("Teleboy mock listening on http://%s:%d\n" % server.server_address[:2])
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()